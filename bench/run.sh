@@ -0,0 +1,26 @@
+#!/bin/sh
+# builds the benchmarks of this directory against the compiler
+# sources (all but main.cpp, optimized) and runs them on the test
+# programs; needs g++ and Boost.
+# usage : run.sh [build directory]
+DIR=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$DIR/.." && pwd)
+BUILD=${1:-/tmp/jack_bench}
+CXX=${CXX:-g++}
+LIBS="-lboost_filesystem -lboost_system -lboost_iostreams -lboost_thread -lpthread"
+
+mkdir -p "$BUILD" || exit 1
+
+OBJECTS=
+for src in "$ROOT"/*.cpp; do
+	[ "$(basename "$src")" = "main.cpp" ] && continue
+	obj="$BUILD/$(basename "$src" .cpp).o"
+	OBJECTS="$OBJECTS $obj"
+	$CXX -O2 -DNDEBUG -w -c -o "$obj" "$src" || exit 1
+done
+
+for bench in "$DIR"/*_bench.cpp; do
+	exe="$BUILD/$(basename "$bench" .cpp)"
+	$CXX -O2 -DNDEBUG -w -I"$ROOT" -o "$exe" "$bench" $OBJECTS $LIBS || exit 1
+	"$exe" "$ROOT/test/p10" "$ROOT/test/p11" || exit 1
+done
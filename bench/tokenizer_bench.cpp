@@ -0,0 +1,123 @@
+/* Lexer throughput : every .jack file given (or found in the
+ * directories given) is read once, then lexed and walked token
+ * by token again and again; prints tokens/sec and MB/sec.
+ * Built and run by run.sh
+ * usage : tokenizer_bench [-n REPEAT] (file | directory)...
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "source_file.h"
+
+using namespace std;
+using namespace boost::filesystem;
+
+typedef boost::shared_ptr<SourceFile> source_ptr;
+
+static void add_sources(path p, vector<source_ptr> &sources)
+{
+	if (is_directory(p))
+	{
+		for (directory_iterator it(p), it_end; it != it_end; ++it)
+		{
+			add_sources(it->path(), sources);
+		}
+	}
+	else if (is_regular_file(p) && p.extension() == ".jack")
+	{
+		sources.push_back( source_ptr(new SourceFile(p, false)) );
+	}
+}
+
+// lexes the source and walks every token, as the compiler does
+static size_t lex(SourceView jackcode)
+{
+	JackTokenizer jtok(jackcode);
+	size_t count = 0;
+
+	try
+	{
+		while (jtok.hasMoreTokens())
+		{
+			jtok.advance();
+			count++;
+		}
+	}
+	catch (const LexicalError&)
+	{
+	}
+
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	int repeat = 200;
+	vector<source_ptr> sources;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg == "-n" && i + 1 < argc)
+		{
+			repeat = max(atoi(argv[++i]), 1);
+		}
+		else if (exists(arg))
+		{
+			add_sources(arg, sources);
+		}
+		else
+		{
+			cout << arg << " does not exist" << endl;
+			return 1;
+		}
+	}
+
+	if (sources.empty())
+	{
+		cout << "usage: " << argv[0] << " [-n REPEAT] (file | directory)..." << endl;
+		return 1;
+	}
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		bytes += sources[i]->view().size;
+	}
+
+	// one run first, so that the timed ones don't pay for the first allocations
+	size_t tokens = 0;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		tokens += lex(sources[i]->view());
+	}
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+	for (int r = 0; r < repeat; r++)
+	{
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			lex(sources[i]->view());
+		}
+	}
+
+	double seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+
+	cout << sources.size() << " file(s), " << bytes << " bytes, " << tokens << " tokens, "
+		<< repeat << " runs in " << seconds << " s" << endl;
+
+	if (seconds > 0)
+	{
+		cout << static_cast<double>(tokens) * repeat / seconds << " tokens/sec, "
+			<< static_cast<double>(bytes) * repeat / seconds / (1024 * 1024) << " MB/sec" << endl;
+	}
+
+	return 0;
+}
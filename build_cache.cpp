@@ -0,0 +1,340 @@
+#include <fstream>
+#include <sstream>
+#include "build_cache.h"
+
+using namespace std;
+
+static const char *CACHE_DIRNAME = ".jackcache";
+static const char *INDEX_FILENAME = "index";
+// bump it whenever the index layout changes
+static const int INDEX_FORMAT = 3;
+
+static const boost::uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+// 64-bit FNV-1a, continued from h
+static boost::uint64_t fnv1a(const char *data, size_t size, boost::uint64_t h)
+{
+	const boost::uint64_t prime = 1099511628211ULL;
+
+	for (const char *c = data, *end = data + size; c != end; ++c)
+	{
+		h = (h ^ static_cast<unsigned char>(*c)) * prime;
+	}
+
+	return h;
+}
+
+static boost::uint64_t hash_of(const string &content)
+{
+	return fnv1a(content.data(), content.size(), FNV_OFFSET);
+}
+
+/* read or write a whole file, in binary mode
+*/
+static bool read_contents(path p, string &content)
+{
+	std::ifstream in(p.string().c_str(), ios::in | ios::binary);
+	if (!in)
+		return false;
+
+	ostringstream buffer;
+	buffer << in.rdbuf();
+
+	content = buffer.str();
+	return true;
+}
+
+static bool write_contents(path p, const string &content)
+{
+	std::ofstream out(p.string().c_str(), ios::out | ios::binary | ios::trunc);
+	if (!out)
+		return false;
+
+	out.write(content.data(), content.size());
+	return !out.fail();
+}
+
+BuildCache::BuildCache(path sourceDirectory, const CodegenOptions &options, bool persistent)
+	:m_sourceDirectory(sourceDirectory), m_options(options.key()), m_extension(options.extension())
+{
+	if (!persistent)
+		return;
+
+	m_directory = sourceDirectory / CACHE_DIRNAME;
+
+	boost::system::error_code ec;
+	boost::filesystem::create_directories(m_directory, ec);
+
+	load();
+}
+
+boost::uint64_t BuildCache::hashOf(SourceView jackcode) const
+{
+	// 64-bit FNV-1a over the content, the version and the options
+	boost::uint64_t h = fnv1a(jackcode.data, jackcode.size, FNV_OFFSET);
+
+	string key = string("\n") + JACK_COMPILER_VERSION + "\n" + m_options;
+	return fnv1a(key.data(), key.size(), h);
+}
+
+path BuildCache::outputOf(path p) const
+{
+	p.replace_extension( m_extension );
+	return p;
+}
+
+path BuildCache::cachedOutput(path p) const
+{
+	return m_directory / outputOf( p.filename() );
+}
+
+bool BuildCache::lookup(path p, SourceView jackcode, ProgramIndex &index)
+{
+	string filename = p.filename().string();
+	boost::uint64_t hash = hashOf(jackcode);
+	Entry entry;
+
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+
+		map<string, Entry>::iterator it = m_entries.find( filename );
+		if (it == m_entries.end() || it->second.hash != hash)
+			return false;
+
+		entry = it->second;
+	}
+
+	index.addClass( entry.className, entry.methods );
+	return true;
+}
+
+bool BuildCache::dependenciesHold(const Entry &entry, const ProgramIndex &index) const
+{
+	for (map<string, SubroutineInfo>::const_iterator it = entry.dependencies.begin(), it_end = entry.dependencies.end();
+		it != it_end; ++it)
+	{
+		string::size_type dot = it->first.find('.');
+		string className = it->first.substr(0, dot);
+		string subr_name = it->first.substr(dot + 1);
+
+		// the class wasn't part of the program, it must still be absent
+		if (it->second.kind.empty())
+		{
+			if (index.hasClass(className))
+				return false;
+			continue;
+		}
+
+		const SubroutineInfo *subr = index.find(className, subr_name);
+		if (subr == 0 || subr->kind != it->second.kind || subr->nArgs != it->second.nArgs)
+			return false;
+	}
+
+	return true;
+}
+
+bool BuildCache::restore(path p, const ProgramIndex &index)
+{
+	string filename = p.filename().string();
+	Entry entry;
+
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+
+		map<string, Entry>::iterator it = m_entries.find( filename );
+		if (it == m_entries.end())
+			return false;
+
+		entry = it->second;
+	}
+
+	if ( !dependenciesHold(entry, index) )
+		return false;
+
+	string cached = entry.output;
+	if ( !m_directory.empty() && !read_contents(cachedOutput(p), cached) )
+		return false;
+
+	// the copy in the cache must be the one that was stored
+	if ( hash_of(cached) != entry.outputHash )
+		return false;
+
+	// the .vm is only written again if it was removed or modified
+	path output = outputOf(p);
+	string current;
+
+	if ( !read_contents(output, current) || hash_of(current) != entry.outputHash )
+	{
+		if ( !write_contents(output, cached) )
+			return false;
+	}
+
+	return true;
+}
+
+void BuildCache::store(path p, SourceView jackcode, string className,
+	const map<string, SubroutineInfo> &methods, const map<string, SubroutineInfo> &dependencies)
+{
+	Entry entry;
+
+	if ( !read_contents(outputOf(p), entry.output) )
+		return;
+
+	entry.outputHash = hash_of(entry.output);
+
+	// the copy is kept in the directory, if there's one
+	if ( !m_directory.empty() )
+	{
+		if ( !write_contents(cachedOutput(p), entry.output) )
+			return;
+
+		entry.output.clear();
+	}
+
+	entry.hash = hashOf(jackcode);
+	entry.className = className;
+	entry.methods = methods;
+	entry.dependencies = dependencies;
+
+	string filename = p.filename().string();
+
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_entries[filename] = entry;
+}
+
+/*
+the index is a text file :
+	jackcache <format> <version>
+	file <hash> <output hash> <className> <nSubroutines> <nDependencies> <filename>
+	<name> <kind> <type> <nArgs>				(once per subroutine)
+	<Class.name> <kind> <type> <nArgs>		(once per dependency, '-' for an empty field)
+*/
+static void write_signatures(ostream &out, const map<string, SubroutineInfo> &signatures)
+{
+	for (map<string, SubroutineInfo>::const_iterator it = signatures.begin(), it_end = signatures.end(); it != it_end; ++it)
+	{
+		const SubroutineInfo &info = it->second;
+		out << it->first << " " << (info.kind.empty() ? "-" : info.kind) << " "
+			<< (info.type.empty() ? "-" : info.type) << " " << info.nArgs << "\n";
+	}
+}
+
+static bool read_signatures(istream &in, int count, map<string, SubroutineInfo> &signatures)
+{
+	for (int i = 0; i < count && in; i++)
+	{
+		string name;
+		SubroutineInfo info;
+		in >> name >> info.kind >> info.type >> info.nArgs;
+
+		if (info.kind == "-")
+			info.kind = "";
+		if (info.type == "-")
+			info.type = "";
+
+		signatures[name] = info;
+	}
+
+	return !in.fail();
+}
+
+void BuildCache::load()
+{
+	std::ifstream in( (m_directory / INDEX_FILENAME).string().c_str() );
+	if (!in)
+		return;
+
+	string magic, version;
+	int format = 0;
+	in >> magic >> format >> version;
+	if (magic != "jackcache" || format != INDEX_FORMAT || version != JACK_COMPILER_VERSION)
+		return;
+
+	string tag;
+	while (in >> tag && tag == "file")
+	{
+		Entry entry;
+		int nSubroutines, nDependencies;
+		string filename;
+
+		in >> hex >> entry.hash >> entry.outputHash >> dec >> entry.className >> nSubroutines >> nDependencies;
+		in.ignore(1);
+		getline(in, filename);
+
+		if ( !read_signatures(in, nSubroutines, entry.methods)
+			|| !read_signatures(in, nDependencies, entry.dependencies) )
+			return;
+
+		m_entries[filename] = entry;
+	}
+}
+
+void BuildCache::save()
+{
+	boost::system::error_code ec;
+
+	// a file out of this run is kept as long as its source exists
+	for (map<string, Entry>::iterator it = m_entries.begin(); it != m_entries.end(); )
+	{
+		if ( boost::filesystem::exists(m_sourceDirectory / it->first, ec) )
+		{
+			++it;
+			continue;
+		}
+
+		if ( !m_directory.empty() )
+		{
+			boost::filesystem::remove(cachedOutput(it->first), ec);
+		}
+
+		m_entries.erase(it++);
+	}
+
+	if (m_directory.empty())
+		return;
+
+	// copies left by an older index (other options, format...)
+	set<string> copies;
+	for (map<string, Entry>::iterator it = m_entries.begin(), it_end = m_entries.end(); it != it_end; ++it)
+	{
+		copies.insert( cachedOutput(it->first).filename().string() );
+	}
+
+	vector<path> orphans;
+	for (boost::filesystem::directory_iterator it(m_directory, ec), it_end; !ec && it != it_end; it.increment(ec))
+	{
+		string name = it->path().filename().string();
+
+		if (name != INDEX_FILENAME && copies.find(name) == copies.end())
+			orphans.push_back( it->path() );
+	}
+
+	for (size_t i = 0; i < orphans.size(); i++)
+	{
+		boost::filesystem::remove(orphans[i], ec);
+	}
+
+	// written aside then renamed, so that an interrupted run can't corrupt it
+	path index_path = m_directory / INDEX_FILENAME;
+	path tmp_path = m_directory / (string(INDEX_FILENAME) + ".tmp");
+
+	{
+		std::ofstream out( tmp_path.string().c_str(), ios::out | ios::trunc );
+		if (!out)
+			return;
+
+		out << "jackcache " << INDEX_FORMAT << " " << JACK_COMPILER_VERSION << "\n";
+
+		for (map<string, Entry>::iterator it = m_entries.begin(), it_end = m_entries.end(); it != it_end; ++it)
+		{
+			const Entry &entry = it->second;
+			out << "file " << hex << entry.hash << " " << entry.outputHash << dec << " " << entry.className << " "
+				<< entry.methods.size() << " " << entry.dependencies.size() << " " << it->first << "\n";
+
+			write_signatures(out, entry.methods);
+			write_signatures(out, entry.dependencies);
+		}
+	}
+
+	boost::filesystem::rename(tmp_path, index_path, ec);
+}
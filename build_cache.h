@@ -0,0 +1,95 @@
+#ifndef _BUILD_CACHE_H
+#define _BUILD_CACHE_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include "jack_tokenizer.h"
+#include "program_index.h"
+#include "type_utils.h"
+#include "codegen_options.h"
+
+using std::string;
+using std::map;
+using std::set;
+using boost::filesystem::path;
+
+// bump it whenever the generated code changes
+#define JACK_COMPILER_VERSION "1.2"
+
+/**
+Persistent cache of the compiled files, stored in a
+directory next to the sources (.jackcache) : for every file, the hash
+of its content (with the compiler version and the options),
+its class signatures, the signatures of the other classes
+it called and a copy of the generated .vm (or .vmb).
+A file is restored instead of being compiled when neither
+its content nor the signatures it called have changed.
+A cache that isn't persistent only lives in memory, for
+a process compiling the same files again (compile server).
+The entries of files left out of a run (a single file
+compiled) are kept, only those of removed sources are dropped.
+Files can be stored concurrently
+*/
+class BuildCache : private boost::noncopyable {
+public:
+	BuildCache(path sourceDirectory, const CodegenOptions &options, bool persistent = true);
+
+	/**
+	If the file content didn't change since it was cached,
+	adds its class to the index and returns true; the file
+	may still have to be compiled, see restore()
+	*/
+	bool lookup(path p, SourceView jackcode, ProgramIndex &index);
+	/**
+	Once the index is complete : if every signature the file
+	called is unchanged, restores its .vm and returns true
+	*/
+	bool restore(path p, const ProgramIndex &index);
+	/**
+	Records a successfully compiled file (its .vm must be written)
+	*/
+	void store(path p, SourceView jackcode, string className,
+		const map<string, SubroutineInfo> &methods, const map<string, SubroutineInfo> &dependencies);
+	/**
+	Drops the entries of the sources that no longer exist (and
+	their copies), then writes the cache index if it's persistent
+	*/
+	void save();
+
+private:
+	struct Entry {
+		boost::uint64_t hash;
+		// of the generated file, to tell whether the output was modified
+		boost::uint64_t outputHash;
+		string className;
+		map<string, SubroutineInfo> methods;
+		// map< Class.subroutine, signature >, an empty kind for a class outside of the program
+		map<string, SubroutineInfo> dependencies;
+		// the generated file, when there's no cache directory
+		string output;
+	};
+
+	path m_sourceDirectory;
+	// empty for a cache in memory
+	path m_directory;
+	// the options part of the key
+	string m_options;
+	// of the generated files
+	string m_extension;
+	boost::mutex m_mutex;
+	// map< source filename, entry >
+	map<string, Entry> m_entries;
+
+	boost::uint64_t hashOf(SourceView jackcode) const;
+	bool dependenciesHold(const Entry &entry, const ProgramIndex &index) const;
+	path outputOf(path p) const;
+	path cachedOutput(path p) const;
+	void load();
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "char_scanner.h"
+
+#if !defined(JACK_NO_SIMD) && (defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__))
+#define JACK_SSE2_SCANNER
+#endif
+
+#ifdef JACK_SSE2_SCANNER
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SSE2_FUNC
+#else
+#include <cpuid.h>
+#define SSE2_FUNC __attribute__((target("sse2")))
+#endif
+#endif
+
+/* character classes table */
+
+#define O CC_OTHER
+#define W CC_SEPARATOR
+#define S CC_SYMBOL
+#define D CC_DIGIT
+#define I CC_IDENT
+#define Q CC_QUOTE
+
+const unsigned char CharScanner::s_charClass[256] = {
+	O, O, O, O, O, O, O, O, O, W, W, O, O, W, O, O, // 0x00
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0x10
+	W, O, Q, O, O, O, S, O, S, S, S, S, S, S, S, S, // 0x20
+	D, D, D, D, D, D, D, D, D, D, O, S, S, S, S, O, // 0x30
+	O, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, // 0x40
+	I, I, I, I, I, I, I, I, I, I, I, S, O, S, O, I, // 0x50
+	O, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, // 0x60
+	I, I, I, I, I, I, I, I, I, I, I, S, S, S, S, O, // 0x70
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0x80
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0x90
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0xA0
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0xB0
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0xC0
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0xD0
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0xE0
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, // 0xF0
+};
+
+#undef O
+#undef W
+#undef S
+#undef D
+#undef I
+#undef Q
+
+/* scalar versions */
+
+static inline bool is_separator(char c)
+{
+	return CharScanner::classOf(c) == CC_SEPARATOR;
+}
+
+static inline bool is_word_char(char c)
+{
+	CHAR_CLASS cc = CharScanner::classOf(c);
+	return cc == CC_IDENT || cc == CC_DIGIT;
+}
+
+static const char* scalar_skipSeparators(const char *p, const char *end)
+{
+	while (p < end && is_separator(*p)) p++;
+	return p;
+}
+
+static const char* scalar_skipWordChars(const char *p, const char *end)
+{
+	while (p < end && is_word_char(*p)) p++;
+	return p;
+}
+
+static const char* scalar_findChar(const char *p, const char *end, char c)
+{
+	while (p < end && *p != c) p++;
+	return p;
+}
+
+static int scalar_countNewlines(const char *p, const char *end, const char *&last_nl)
+{
+	int count = 0;
+	for (; p < end; p++)
+	{
+		if (*p == '\n')
+		{
+			count++;
+			last_nl = p;
+		}
+	}
+	return count;
+}
+
+#ifdef JACK_SSE2_SCANNER
+
+/* SSE2 versions : each one works on 16 bytes blocks
+ * then lets the scalar version finish the tail
+ */
+
+static inline int first_bit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return (int)idx;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline int last_bit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanReverse(&idx, mask);
+	return (int)idx;
+#else
+	return 31 - __builtin_clz(mask);
+#endif
+}
+
+SSE2_FUNC static const char* sse2_skipSeparators(const char *p, const char *end)
+{
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+
+	while (end - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+		unsigned int mask = ~_mm_movemask_epi8(m) & 0xFFFF;
+
+		if (mask != 0)
+			return p + first_bit(mask);
+		p += 16;
+	}
+	return scalar_skipSeparators(p, end);
+}
+
+SSE2_FUNC static const char* sse2_skipWordChars(const char *p, const char *end)
+{
+	const __m128i case_bit = _mm_set1_epi8(0x20);
+	const __m128i before_a = _mm_set1_epi8('a' - 1);
+	const __m128i after_z = _mm_set1_epi8('z' + 1);
+	const __m128i before_0 = _mm_set1_epi8('0' - 1);
+	const __m128i after_9 = _mm_set1_epi8('9' + 1);
+	const __m128i underscore = _mm_set1_epi8('_');
+
+	while (end - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		// bytes >= 0x80 are negative, so they never match the ranges
+		__m128i lower = _mm_or_si128(v, case_bit);
+		__m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, before_a), _mm_cmpgt_epi8(after_z, lower));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, before_0), _mm_cmpgt_epi8(after_9, v));
+		__m128i m = _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(v, underscore));
+		unsigned int mask = ~_mm_movemask_epi8(m) & 0xFFFF;
+
+		if (mask != 0)
+			return p + first_bit(mask);
+		p += 16;
+	}
+	return scalar_skipWordChars(p, end);
+}
+
+SSE2_FUNC static const char* sse2_findChar(const char *p, const char *end, char c)
+{
+	const __m128i needle = _mm_set1_epi8(c);
+
+	while (end - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+
+		if (mask != 0)
+			return p + first_bit(mask);
+		p += 16;
+	}
+	return scalar_findChar(p, end, c);
+}
+
+SSE2_FUNC static int sse2_countNewlines(const char *p, const char *end, const char *&last_nl)
+{
+	const __m128i lf = _mm_set1_epi8('\n');
+	int count = 0;
+
+	while (end - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+
+		if (mask != 0)
+		{
+			last_nl = p + last_bit(mask);
+			for (; mask != 0; mask &= mask - 1)
+				count++;
+		}
+		p += 16;
+	}
+	return count + scalar_countNewlines(p, end, last_nl);
+}
+
+static bool detect_sse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	// always there on x86-64
+	return true;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (edx & (1 << 26)) != 0;
+#endif
+}
+
+static const bool s_use_sse2 = detect_sse2();
+
+#else
+
+static const bool s_use_sse2 = false;
+
+#endif
+
+/* dispatching */
+
+bool CharScanner::usesSIMD()
+{
+	return s_use_sse2;
+}
+
+const char* CharScanner::skipSeparators(const char *p, const char *end)
+{
+#ifdef JACK_SSE2_SCANNER
+	if (s_use_sse2) return sse2_skipSeparators(p, end);
+#endif
+	return scalar_skipSeparators(p, end);
+}
+
+const char* CharScanner::skipWordChars(const char *p, const char *end)
+{
+#ifdef JACK_SSE2_SCANNER
+	if (s_use_sse2) return sse2_skipWordChars(p, end);
+#endif
+	return scalar_skipWordChars(p, end);
+}
+
+const char* CharScanner::findChar(const char *p, const char *end, char c)
+{
+#ifdef JACK_SSE2_SCANNER
+	if (s_use_sse2) return sse2_findChar(p, end, c);
+#endif
+	return scalar_findChar(p, end, c);
+}
+
+int CharScanner::countNewlines(const char *p, const char *end, const char *&last_nl)
+{
+#ifdef JACK_SSE2_SCANNER
+	if (s_use_sse2) return sse2_countNewlines(p, end, last_nl);
+#endif
+	return scalar_countNewlines(p, end, last_nl);
+}
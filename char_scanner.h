@@ -0,0 +1,63 @@
+#ifndef _CHAR_SCANNER_H
+#define _CHAR_SCANNER_H
+
+#include <cstddef>
+
+/* character classes, used by the tokenizer state machine */
+enum CHAR_CLASS {
+	CC_OTHER,
+	CC_SEPARATOR,	// ' ', '\t', '\r', '\n'
+	CC_SYMBOL,		// { } ( ) [ ] . , ; + - * / & | < > = ~
+	CC_DIGIT,		// 0-9
+	CC_IDENT,		// a-z, A-Z, '_'
+	CC_QUOTE		// '"'
+};
+
+/**
+Scanning kernels used by the tokenizer to skip
+runs of characters (separators, comment bodies,
+identifier chars) 16 bytes at a time.
+The SSE2 version is selected at runtime when
+the CPU supports it (define JACK_NO_SIMD to
+disable it), otherwise a scalar loop is used.
+Every function returns a pointer in [p, end]
+*/
+class CharScanner {
+public:
+	/**
+	Returns the class of a character
+	(a single table load)
+	*/
+	static CHAR_CLASS classOf(char c)
+	{
+		return (CHAR_CLASS)s_charClass[(unsigned char)c];
+	}
+	/**
+	Returns the first char which is not
+	a separator (' ', '\t', '\r', '\n')
+	*/
+	static const char* skipSeparators(const char *p, const char *end);
+	/**
+	Returns the first char which is not
+	a letter, a digit or '_'
+	*/
+	static const char* skipWordChars(const char *p, const char *end);
+	/**
+	Returns the first occurrence of c
+	*/
+	static const char* findChar(const char *p, const char *end, char c);
+	/**
+	Counts the '\n' in [p, end) and stores the
+	last one in last_nl (untouched if there's none)
+	*/
+	static int countNewlines(const char *p, const char *end, const char *&last_nl);
+	/**
+	Is the SSE2 version in use ?
+	*/
+	static bool usesSIMD();
+
+private:
+	static const unsigned char s_charClass[256];
+};
+
+#endif
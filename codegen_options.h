@@ -0,0 +1,55 @@
+#ifndef _CODEGEN_OPTIONS_H
+#define _CODEGEN_OPTIONS_H
+
+#include <string>
+#include <sstream>
+
+using std::string;
+using std::ostringstream;
+
+enum VM_FORMAT {
+	VM_TEXT,	// .vm
+	VM_BINARY	// .vmb, see vm_code.h
+};
+
+/**
+Options changing the generated code, given to
+JackCompilationEngine through JackCompiler
+*/
+struct CodegenOptions {
+public:
+	VM_FORMAT format;
+	// PEEPHOLE_PATTERN flags (see peephole.h), 0 : no peephole pass
+	unsigned int peephole;
+	// multiplications and divisions by constants become add chains
+	bool reduceStrength;
+	/* every distinct string literal of a class is built once,
+	 * on its first use, and kept in a static variable : the
+	 * program must not modify nor dispose them
+	 */
+	bool poolStrings;
+
+	CodegenOptions():format(VM_TEXT), peephole(0), reduceStrength(false), poolStrings(false) {}
+
+	// extension of the generated file
+	string extension() const { return format == VM_BINARY ? ".vmb" : ".vm"; }
+
+	// identifies the options in the build cache key
+	string key() const
+	{
+		ostringstream k;
+
+		if (format == VM_BINARY)
+			k << "vmb ";
+		if (peephole != 0)
+			k << "peephole=" << peephole << " ";
+		if (reduceStrength)
+			k << "strength ";
+		if (poolStrings)
+			k << "strings ";
+
+		return k.str();
+	}
+};
+
+#endif
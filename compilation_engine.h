@@ -5,14 +5,19 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <iostream>
 #include <stdexcept>
 #include <boost/filesystem.hpp>
 #include "jack_tokenizer.h"
 #include "vm_writer.h"
 #include "symbol_table.h"
+#include "program_index.h"
+#include "codegen_options.h"
+#include "peephole.h"
 
 using std::string;
 using std::ofstream;
+using std::ostream;
 using std::vector;
 using std::ostringstream;
 using boost::filesystem::path;
@@ -44,7 +49,11 @@ protected:
 
 class XMLCompilationEngine : public CompilationEngine {
 public:
-	XMLCompilationEngine(JackTokenizer &jtok, path p);
+	/**
+	The XML goes to out, or when it's null,
+	to the .xml file next to the source p
+	*/
+	XMLCompilationEngine(JackTokenizer &jtok, path p, ostream &diag = std::cerr, ostream *out = 0);
 
 	virtual void compileClass();
 	virtual void compileClassVarDec();
@@ -60,12 +69,18 @@ public:
 	virtual void compileExpression();
 	virtual void compileTerm();
 	virtual void compileExpressionList();
+	// an error was reported, the XML is incomplete
+	bool hasFailed();
 private:
 	string m_indent;
 	vector<char> m_op, m_unaryOp;
 	vector<TYPE_KEYWORD> m_kwConstant, m_classVarDec, m_type, m_subroutineDec, m_statement;
 
-	ofstream m_out;
+	ofstream m_file;
+	ostream &m_out;
+	// where errors are reported
+	ostream &m_diag;
+	bool m_failed;
 	string m_fileName;
 
 	// increment/decrement tabulation needed for XML reading comfort
@@ -91,7 +106,9 @@ private:
 
 class JackCompilationEngine : public CompilationEngine {
 public:
-	JackCompilationEngine( JackTokenizer &jtok, path p, map<string,SubroutineInfo> ref_methods = map<string,SubroutineInfo>() );
+	JackCompilationEngine( JackTokenizer &jtok, path p, map<string,SubroutineInfo> ref_methods = map<string,SubroutineInfo>(),
+		const ProgramIndex *index = 0, ostream &diag = std::cerr, ostream *vm_out = 0,
+		const CodegenOptions &options = CodegenOptions() );
 
 	virtual void compileClass();
 	virtual void compileClassVarDec();
@@ -112,10 +129,18 @@ public:
 	void popIdentifier(KIND kind, int index);
 	// map< method name, number of LocalVar >
 	map<string, SubroutineInfo> getMethodList();
+	// an error was reported, the .vm is incomplete
+	bool hasFailed();
+	// map< Class.subroutine, signature > of the other classes called
+	map<string, SubroutineInfo> getExternDependencies();
 
 private:
+	CodegenOptions m_options;
 	// vmwriter
 	VMWriter m_VMOutput;
+	// where errors are reported
+	ostream &m_diag;
+	bool m_failed;
 	// symbol table
 	SymbolTable m_symTab;
 
@@ -126,15 +151,34 @@ private:
 	string m_currentSubroutine_name, m_currentSubroutine_kind, m_currentSubroutine_type;
 	/* we need to determine every subroutine (specially methods) of the class BEFORE
 	 * outputting VM inst. so we'll make 2 pass.
-	 * The 1st one is to fill this member class
+	 * The 1st one (see DeclarationScanner) is to fill this member class
 	 */
-	map<string, SubroutineInfo> m_classSubroutine_params;
+	map<Atom, SubroutineInfo> m_classSubroutine_params;
+	// signatures of every class of the program (may be null)
+	const ProgramIndex *m_index;
 	// count how many arguments used for other subroutines called
 	int m_externSubroutine_params;
+	/* signatures checked against the program index, an empty kind
+	 * means the class wasn't part of the program
+	 */
+	map<string, SubroutineInfo> m_externDependencies;
 
 	// 'if' and 'while' counters
 	int m_ifCounter, m_whileCounter;
 
+	/* pooled strings : map< literal, index in the pool >, the pool
+	 * takes the static variables after those of the class
+	 */
+	map<string, int> m_stringPool;
+	int m_stringCounter;
+
+	/* set by compileTerm() and compileExpression() : whether
+	 * the code just compiled only pushes a constant, and its
+	 * value (16-bit). Constant subexpressions are folded
+	 */
+	bool m_isConstant;
+	int m_constantValue;
+
 	// keywords and symbols constants
 	vector<char> m_op, m_unaryOp;
 	vector<TYPE_KEYWORD> m_kwConstant, m_classVarDec, m_type, m_subroutineDec, m_statement;
@@ -154,6 +198,26 @@ private:
 	void inspectOp();
 	void inspectUnaryOp();
 	void inspectType();
+
+	// the type at the current token (keyword or className)
+	Atom typeAtom();
+
+	// folding : evaluates 'left op right' as the VM would, false if it can't be
+	bool foldOperation( char op, int left, int right, int &result );
+	// pushes a 16-bit value in as few instructions as possible
+	void pushConstant( int value );
+	// String.new and one appendChar per character
+	void buildString( const string &str );
+	void pushPooledString( const string &str );
+	/* strength reduction : the code of the operands is in [start, operand) and
+	 * [operand, end), one of them is the constant factor. False if the call
+	 * to Math.multiply (Math.divide) is kept
+	 */
+	bool reduceMultiply( size_t start, size_t operand, bool constantLeft, int factor );
+	bool reduceDivide( size_t operand, int divisor );
+
+	// validate className.subroutineName against the program index
+	void checkExternalCall( const string &className, const string &subr_name, bool onObject, int nArgs, int line, int column );
 };
 
 /** Handled exception */
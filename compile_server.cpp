@@ -0,0 +1,503 @@
+#include <sstream>
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+#include "compile_server.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <ctime>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
+#define JACK_HAS_UNIX_SOCKETS
+#endif
+
+using namespace std;
+
+/*
+every field of a request is prefixed by its size, so that
+it can hold any character (a path with a new line...) :
+	request  : <field count>\n then, per field, <size>\n<field>
+	           the working directory, then the arguments
+	response : <exit status> <output size> <error size>\n<output><errors>
+in-memory units replace the working directory, and follow the arguments :
+	request  : the field "@units <count>", the arguments,
+	           then, per unit, its name and its content as two fields
+	output   : per unit, <succeeded> <name size> <output size> <diagnostics size>\n<name><output><diagnostics>
+*/
+
+static const string UNITS_TAG = "@units ";
+
+#ifdef JACK_HAS_UNIX_SOCKETS
+
+static bool write_all(int fd, const string &data)
+{
+	const char *ptr = data.data();
+	size_t left = data.size();
+
+	while (left > 0)
+	{
+		ssize_t n = write(fd, ptr, left);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+
+		ptr += n;
+		left -= n;
+	}
+
+	return true;
+}
+
+static bool make_address(const string &socketPath, struct sockaddr_un &addr)
+{
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (socketPath.size() >= sizeof(addr.sun_path))
+		return false;
+
+	strcpy(addr.sun_path, socketPath.c_str());
+	return true;
+}
+
+// appends what is available to data : the number of bytes read,
+// 0 at the end of the stream, -1 on error or once 'deadline' is over
+// (0 : no deadline)
+static ssize_t read_some(int fd, string &data, time_t deadline)
+{
+	char buffer[4096];
+
+	for (;;)
+	{
+		if (deadline != 0)
+		{
+			time_t left = deadline - time(0);
+			if (left <= 0)
+				return -1;
+
+			struct pollfd p;
+			p.fd = fd;
+			p.events = POLLIN;
+
+			int ready = poll(&p, 1, static_cast<int>(left) * 1000);
+			if (ready < 0 && errno == EINTR)
+				continue;
+			if (ready <= 0)
+				return -1;
+		}
+
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n > 0)
+			data.append(buffer, n);
+
+		return n;
+	}
+}
+
+// reads until the peer closes the connection
+static bool read_all(int fd, string &data)
+{
+	for (;;)
+	{
+		ssize_t n = read_some(fd, data, 0);
+		if (n <= 0)
+			return n == 0;
+	}
+}
+
+// reads until data holds at least 'size' bytes
+static bool read_size(int fd, string &data, size_t size, time_t deadline)
+{
+	while (data.size() < size)
+	{
+		if (read_some(fd, data, deadline) <= 0)
+			return false;
+	}
+
+	return true;
+}
+
+// reads the number ending the line at 'offset', then moves past it
+static bool read_number(int fd, string &request, size_t &offset, size_t &number, time_t deadline)
+{
+	while (request.find('\n', offset) == string::npos)
+	{
+		if (read_some(fd, request, deadline) <= 0)
+			return false;
+	}
+
+	size_t eol = request.find('\n', offset);
+	istringstream line(request.substr(offset, eol - offset));
+
+	if (!(line >> number))
+		return false;
+
+	offset = eol + 1;
+	return true;
+}
+
+/* reads the field at 'offset' : it's found at 'start' in the
+request, then moves past it
+*/
+static bool read_field(int fd, string &request, size_t &offset, size_t &start, size_t &size, time_t deadline)
+{
+	if (!read_number(fd, request, offset, size, deadline) || !read_size(fd, request, offset + size, deadline))
+		return false;
+
+	start = offset;
+	offset += size;
+	return true;
+}
+
+static bool read_field(int fd, string &request, size_t &offset, string &field, time_t deadline)
+{
+	size_t start, size;
+	if (!read_field(fd, request, offset, start, size, deadline))
+		return false;
+
+	field = request.substr(start, size);
+	return true;
+}
+
+static void write_field(ostream &out, const char *data, size_t size)
+{
+	out << size << "\n";
+	out.write(data, size);
+}
+
+static void write_field(ostream &out, const string &field)
+{
+	write_field(out, field.data(), field.size());
+}
+
+/* reads the units following the arguments, from 'offset' in
+the request ; their views point into the request
+*/
+static bool read_units(int fd, string &request, size_t offset, int count, vector<SourceUnit> &units, time_t deadline)
+{
+	// (name, offset, size) : the request may grow, views are made at the end
+	vector< pair<string, pair<size_t, size_t> > > found;
+
+	for (int i = 0; i < count; i++)
+	{
+		string name;
+		size_t start, size;
+
+		if (!read_field(fd, request, offset, name, deadline) || name.empty()
+			|| !read_field(fd, request, offset, start, size, deadline))
+			return false;
+
+		found.push_back( make_pair(name, make_pair(start, size)) );
+	}
+
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		units.push_back( SourceUnit(found[i].first, SourceView(request.data() + found[i].second.first, found[i].second.second)) );
+	}
+
+	return true;
+}
+
+/* sends a request, then reads the exit status and both outputs
+of the response; false if the server can't be reached
+*/
+static bool exchange(const string &socketPath, const string &request, int &status, string &output, string &errors)
+{
+	struct sockaddr_un addr;
+	if (!make_address(socketPath, addr))
+		return false;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+
+	if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	string response;
+	bool ok = write_all(fd, request) && read_all(fd, response);
+	close(fd);
+
+	if (!ok)
+		return false;
+
+	// exit status, then the sizes of both outputs
+	istringstream in(response);
+	size_t out_size, err_size;
+
+	if (!(in >> status >> out_size >> err_size))
+		return false;
+
+	size_t start = response.find('\n') + 1;
+	if (response.size() < start + out_size + err_size)
+		return false;
+
+	output = response.substr(start, out_size);
+	errors = response.substr(start + out_size, err_size);
+	return true;
+}
+
+CompileServer::CompileServer(string socketPath, Handler handler, UnitHandler unitHandler)
+	:m_socketPath(socketPath), m_handler(handler), m_unitHandler(unitHandler), m_fd(-1)
+{
+	struct sockaddr_un addr;
+	if (!make_address(socketPath, addr))
+		return;
+
+	// a client leaving early must not kill the server
+	signal(SIGPIPE, SIG_IGN);
+
+	m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_fd < 0)
+		return;
+
+	// a previous server may have left its socket behind
+	unlink(socketPath.c_str());
+
+	if (bind(m_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || listen(m_fd, 16) < 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+CompileServer::~CompileServer()
+{
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+		unlink(m_socketPath.c_str());
+	}
+}
+
+bool CompileServer::isListening() const
+{
+	return m_fd >= 0;
+}
+
+void CompileServer::run()
+{
+	while (isListening())
+	{
+		int client = accept(m_fd, 0, 0);
+		if (client < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			return;
+		}
+
+		// a client that stops reading the response must not block the server either
+		struct timeval timeout;
+		timeout.tv_sec = REQUEST_TIMEOUT;
+		timeout.tv_usec = 0;
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		serve(client);
+		close(client);
+	}
+}
+
+void CompileServer::serve(int client)
+{
+	// a silent or stalled client gives up its turn after the deadline
+	time_t deadline = time(0) + REQUEST_TIMEOUT;
+
+	string request;
+	size_t offset = 0, count;
+
+	// the working directory (or the units tag), then the arguments
+	string cwd;
+	vector<string> args;
+
+	if (!read_number(client, request, offset, count, deadline) || count == 0
+		|| !read_field(client, request, offset, cwd, deadline))
+		return;
+
+	for (size_t i = 1; i < count; i++)
+	{
+		string arg;
+		if (!read_field(client, request, offset, arg, deadline))
+			return;
+
+		args.push_back(arg);
+	}
+
+	vector<SourceUnit> units;
+	bool in_memory = (cwd.compare(0, UNITS_TAG.size(), UNITS_TAG) == 0);
+
+	if (in_memory && !read_units(client, request, offset, atoi(cwd.c_str() + UNITS_TAG.size()), units, deadline))
+		return;
+
+	ostringstream out, err;
+	int status = 1;
+
+	try
+	{
+		if (!in_memory)
+		{
+			boost::filesystem::current_path(cwd);
+			status = m_handler(args, out, err);
+		}
+		else if (m_unitHandler)
+		{
+			vector<CompileResult> results;
+			status = m_unitHandler(args, units, results, err);
+
+			for (vector<CompileResult>::const_iterator it = results.begin(), it_end = results.end(); it != it_end; ++it)
+			{
+				out << (it->succeeded ? 1 : 0) << " " << it->name.size() << " " << it->output.size() << " "
+					<< it->diagnostics.size() << "\n" << it->name << it->output << it->diagnostics;
+			}
+		}
+		else
+		{
+			err << "this server doesn't compile in-memory units" << endl;
+		}
+	}
+	catch (const exception &e)
+	{
+		err << e.what() << endl;
+	}
+	catch (...)
+	{
+		err << "internal error" << endl;
+	}
+
+	ostringstream header;
+	header << status << " " << out.str().size() << " " << err.str().size() << "\n";
+
+	write_all(client, header.str() + out.str() + err.str());
+}
+
+int forward_to_server(string socketPath, const vector<string> &args)
+{
+	ostringstream request;
+	request << args.size() + 1 << "\n";
+	write_field(request, boost::filesystem::current_path().string());
+
+	for (vector<string>::const_iterator it = args.begin(), it_end = args.end(); it != it_end; ++it)
+	{
+		write_field(request, *it);
+	}
+
+	int status;
+	string output, errors;
+
+	if (!exchange(socketPath, request.str(), status, output, errors))
+		return -1;
+
+	cout << output;
+	cerr << errors;
+
+	return status;
+}
+
+int compile_on_server(string socketPath, const vector<string> &options, const vector<SourceUnit> &units,
+	vector<CompileResult> &results, string &errors)
+{
+	ostringstream tag;
+	tag << UNITS_TAG << units.size();
+
+	ostringstream request;
+	request << options.size() + 1 << "\n";
+	write_field(request, tag.str());
+
+	for (vector<string>::const_iterator it = options.begin(), it_end = options.end(); it != it_end; ++it)
+	{
+		write_field(request, *it);
+	}
+
+	for (vector<SourceUnit>::const_iterator it = units.begin(), it_end = units.end(); it != it_end; ++it)
+	{
+		write_field(request, it->first);
+		write_field(request, it->second.data, it->second.size);
+	}
+
+	int status;
+	string output;
+
+	if (!exchange(socketPath, request.str(), status, output, errors))
+		return -1;
+
+	// one result per unit, in the same order
+	results.clear();
+	size_t offset = 0;
+
+	while (offset < output.size())
+	{
+		size_t eol = output.find('\n', offset);
+		if (eol == string::npos)
+			return -1;
+
+		istringstream line(output.substr(offset, eol - offset));
+		CompileResult result;
+		int succeeded;
+		size_t name_size, out_size, diag_size;
+
+		if (!(line >> succeeded >> name_size >> out_size >> diag_size))
+			return -1;
+
+		offset = eol + 1;
+		if (output.size() < offset + name_size + out_size + diag_size)
+			return -1;
+
+		result.succeeded = (succeeded != 0);
+		result.name = output.substr(offset, name_size);
+		result.output = output.substr(offset + name_size, out_size);
+		result.diagnostics = output.substr(offset + name_size + out_size, diag_size);
+		results.push_back(result);
+
+		offset += name_size + out_size + diag_size;
+	}
+
+	return status;
+}
+
+#else
+
+CompileServer::CompileServer(string socketPath, Handler handler, UnitHandler unitHandler)
+	:m_socketPath(socketPath), m_handler(handler), m_unitHandler(unitHandler), m_fd(-1)
+{
+}
+
+CompileServer::~CompileServer()
+{
+}
+
+bool CompileServer::isListening() const
+{
+	return false;
+}
+
+void CompileServer::run()
+{
+}
+
+void CompileServer::serve(int client)
+{
+}
+
+int forward_to_server(string socketPath, const vector<string> &args)
+{
+	return -1;
+}
+
+int compile_on_server(string socketPath, const vector<string> &options, const vector<SourceUnit> &units,
+	vector<CompileResult> &results, string &errors)
+{
+	return -1;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _COMPILE_SERVER_H
+#define _COMPILE_SERVER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
+#include "jack_library.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+
+/**
+Compile server listening on a Unix domain socket (Unix only).
+Each request holds the working directory and the command line
+arguments of a client; the handler runs them in that directory
+and its exit status and outputs are sent back. A request can
+also carry the sources themselves (in-memory units), they are
+given to the unit handler with the options and their results
+are sent back.
+Requests are handled one at a time, the handler is free to
+keep its state (thread pool, ...) warm between them; a client
+that doesn't send its whole request within REQUEST_TIMEOUT
+seconds is dropped so that it can't hold the others back
+*/
+class CompileServer : private boost::noncopyable {
+public:
+	// exit status = handler(arguments, standard output, error output)
+	typedef boost::function<int (const vector<string>&, ostream&, ostream&)> Handler;
+	// exit status = unitHandler(options, units, results, error output)
+	typedef boost::function<int (const vector<string>&, const vector<SourceUnit>&,
+		vector<CompileResult>&, ostream&)> UnitHandler;
+
+	static const int REQUEST_TIMEOUT = 5;
+
+	CompileServer(string socketPath, Handler handler, UnitHandler unitHandler = UnitHandler());
+	~CompileServer();
+
+	// false if the platform has no support or the socket can't be bound
+	bool isListening() const;
+	// serves requests until the process is stopped
+	void run();
+
+private:
+	string m_socketPath;
+	Handler m_handler;
+	UnitHandler m_unitHandler;
+	int m_fd;
+
+	void serve(int client);
+};
+
+/**
+Client side : sends the arguments to the server, writes its
+outputs on cout/cerr and returns its exit status
+(-1 if the server can't be reached)
+*/
+int forward_to_server(string socketPath, const vector<string> &args);
+
+/**
+Client side, in-memory : sends the units to the server, which
+compiles them as one program with the given options (those of
+the command line changing the generated code, "-O", ...); the
+results come in the same order as the units, the other errors
+in 'errors'. Returns the exit status (-1 if the server can't be reached)
+*/
+int compile_on_server(string socketPath, const vector<string> &options, const vector<SourceUnit> &units,
+	vector<CompileResult> &results, string &errors);
+
+#endif
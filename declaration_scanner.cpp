@@ -0,0 +1,181 @@
+#include "declaration_scanner.h"
+
+using namespace std;
+
+DeclarationScanner::DeclarationScanner(JackTokenizer &jtok)
+	:m_jtok(jtok)
+{
+	// a class that can't be lexed has no name, the final pass reports the error
+	try
+	{
+		scanClass();
+	}
+	catch (const LexicalError&)
+	{
+		m_className.clear();
+	}
+}
+
+map<string, SubroutineInfo> DeclarationScanner::getMethodList()
+{
+	return m_methods;
+}
+
+string DeclarationScanner::getClassName()
+{
+	return m_className;
+}
+
+void DeclarationScanner::scanClass()
+{
+	// 'class' className '{'
+	if ( !nextKeyword(KW_CLASS) )
+		return;
+
+	m_jtok.advance();
+
+	if ( m_jtok.tokenType() != TOK_IDENTIFIER )
+		return;
+
+	string className = m_jtok.identifier();
+
+	if ( !nextSymbol('{') )
+		return;
+
+	// classVarDec* subroutineDec*
+	for (;;)
+	{
+		m_jtok.advance();
+
+		if ( m_jtok.tokenType() != TOK_KEYWORD )
+		{
+			// the class is only named once all its declarations were read
+			if ( m_jtok.tokenType() == TOK_SYMBOL && m_jtok.symbol() == '}' )
+				m_className = className;
+			return;
+		}
+
+		TYPE_KEYWORD kw = m_jtok.keyword();
+
+		if ( kw == KW_STATIC || kw == KW_FIELD )
+		{
+			if ( !skipPast(';') )
+				return;
+		}
+		else if ( kw == KW_CONSTRUCTOR || kw == KW_FUNCTION || kw == KW_METHOD )
+		{
+			if ( !scanSubroutine(kw) )
+				return;
+		}
+		else
+		{
+			return;
+		}
+	}
+}
+
+bool DeclarationScanner::scanSubroutine(TYPE_KEYWORD kind)
+{
+	// (void | type)
+	m_jtok.advance();
+
+	string type;
+	if ( m_jtok.tokenType() == TOK_KEYWORD )
+	{
+		type = keyword_to_string( m_jtok.keyword() );
+	}
+	else if ( m_jtok.tokenType() == TOK_IDENTIFIER )
+	{
+		type = m_jtok.identifier();
+	}
+	else return false;
+
+	// subroutineName
+	m_jtok.advance();
+
+	if ( m_jtok.tokenType() != TOK_IDENTIFIER )
+		return false;
+
+	SourceView name = m_jtok.tokenView();
+
+	// '(' parameterList ')' : we only count the parameters
+	if ( !nextSymbol('(') )
+		return false;
+
+	int nArgs = 0;
+	bool empty = true;
+	for (;;)
+	{
+		m_jtok.advance();
+
+		TYPE_TOKEN tt = m_jtok.tokenType();
+		if ( tt == TOK_EMPTY )
+			return false;
+
+		if ( tt == TOK_SYMBOL )
+		{
+			char sym = m_jtok.symbol();
+			if ( sym == ')' )
+				break;
+			if ( sym == ',' )
+				nArgs++;
+		}
+		else
+		{
+			empty = false;
+		}
+	}
+	if ( !empty )
+		nArgs++;
+
+	m_methods.insert( pair<string, SubroutineInfo>(name.str(), SubroutineInfo(type, keyword_to_string(kind), nArgs)) );
+
+	// subroutineBody : skipped by brace matching
+	if ( !nextSymbol('{') )
+		return false;
+
+	int depth = 1;
+	while ( depth > 0 )
+	{
+		m_jtok.advance();
+
+		TYPE_TOKEN tt = m_jtok.tokenType();
+		if ( tt == TOK_EMPTY )
+			return false;
+
+		if ( tt == TOK_SYMBOL )
+		{
+			char sym = m_jtok.symbol();
+			if ( sym == '{' ) depth++;
+			else if ( sym == '}' ) depth--;
+		}
+	}
+
+	return true;
+}
+
+bool DeclarationScanner::nextKeyword(TYPE_KEYWORD tk)
+{
+	m_jtok.advance();
+	return m_jtok.tokenType() == TOK_KEYWORD && m_jtok.keyword() == tk;
+}
+
+bool DeclarationScanner::nextSymbol(char symbol)
+{
+	m_jtok.advance();
+	return m_jtok.tokenType() == TOK_SYMBOL && m_jtok.symbol() == symbol;
+}
+
+bool DeclarationScanner::skipPast(char symbol)
+{
+	for (;;)
+	{
+		m_jtok.advance();
+
+		TYPE_TOKEN tt = m_jtok.tokenType();
+		if ( tt == TOK_EMPTY )
+			return false;
+		if ( tt == TOK_SYMBOL && m_jtok.symbol() == symbol )
+			return true;
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef _DECLARATION_SCANNER_H
+#define _DECLARATION_SCANNER_H
+
+#include <string>
+#include <map>
+#include <boost/noncopyable.hpp>
+#include "jack_tokenizer.h"
+#include "type_utils.h"
+
+using std::string;
+using std::map;
+
+/**
+First pass of the compiler : only reads the class and
+subroutine declarations to collect every subroutine
+signature (type, kind, number of arguments).
+Subroutine bodies are skipped by brace matching,
+nothing is written and errors are left to the final pass
+*/
+class DeclarationScanner {
+public:
+	DeclarationScanner(JackTokenizer &jtok);
+
+	// map< subroutine name, signature >
+	map<string, SubroutineInfo> getMethodList();
+	// empty if the declarations couldn't be read up to the closing '}'
+	string getClassName();
+
+private:
+	JackTokenizer &m_jtok;
+	string m_className;
+	map<string, SubroutineInfo> m_methods;
+
+	void scanClass();
+	bool scanSubroutine(TYPE_KEYWORD kind);
+	// advance and check the new current token
+	bool nextKeyword(TYPE_KEYWORD tk);
+	bool nextSymbol(char symbol);
+	// advance until the given symbol is the current token
+	bool skipPast(char symbol);
+};
+
+/**
+A source lexed and scanned once : the index takes its
+signatures, then the compiler replays its tokens
+instead of lexing the source again
+*/
+class ScannedFile : private boost::noncopyable {
+public:
+	explicit ScannedFile(SourceView jackcode)
+		: m_jtok(jackcode), m_declarations(m_jtok)
+	{
+	}
+
+	JackTokenizer& tokenizer() { return m_jtok; }
+	map<string, SubroutineInfo> getMethodList() { return m_declarations.getMethodList(); }
+	string getClassName() { return m_declarations.getClassName(); }
+
+private:
+	JackTokenizer m_jtok;
+	DeclarationScanner m_declarations;
+};
+
+#endif
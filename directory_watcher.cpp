@@ -0,0 +1,110 @@
+#include "directory_watcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+
+// how long the directory must stay quiet before a batch is returned (ms)
+static const int QUIET_PERIOD = 100;
+
+DirectoryWatcher::DirectoryWatcher(path directory)
+	:m_directory(directory), m_fd(-1), m_wd(-1)
+{
+	m_fd = inotify_init();
+	if (m_fd < 0)
+		return;
+
+	m_wd = inotify_add_watch(m_fd, directory.string().c_str(),
+		IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+bool DirectoryWatcher::isWatching() const
+{
+	return m_fd >= 0 && m_wd >= 0;
+}
+
+set<path> DirectoryWatcher::waitForChanges()
+{
+	set<path> changes;
+
+	if ( !isWatching() )
+		return changes;
+
+	// events are variable-sized, the buffer must be aligned for them
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	struct pollfd pfd;
+	pfd.fd = m_fd;
+	pfd.events = POLLIN;
+
+	// block for the first event, then wait for the directory to be quiet
+	int timeout = -1;
+	for (;;)
+	{
+		int ready = poll(&pfd, 1, timeout);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		// the quiet period is over
+		if (ready == 0)
+			break;
+
+		ssize_t len = read(m_fd, buffer, sizeof(buffer));
+		if (len <= 0)
+			break;
+
+		for (char *ptr = buffer; ptr < buffer + len; )
+		{
+			const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(ptr);
+
+			if (event->len > 0)
+				changes.insert( m_directory / event->name );
+
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
+
+		timeout = QUIET_PERIOD;
+	}
+
+	return changes;
+}
+
+#else
+
+DirectoryWatcher::DirectoryWatcher(path directory)
+	:m_directory(directory), m_fd(-1), m_wd(-1)
+{
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+}
+
+bool DirectoryWatcher::isWatching() const
+{
+	return false;
+}
+
+set<path> DirectoryWatcher::waitForChanges()
+{
+	return set<path>();
+}
+
+#endif
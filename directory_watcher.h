@@ -0,0 +1,32 @@
+#ifndef _DIRECTORY_WATCHER_H
+#define _DIRECTORY_WATCHER_H
+
+#include <set>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+
+using std::set;
+using boost::filesystem::path;
+
+/**
+Watches the files of one directory (only on Linux, with inotify) :
+waitForChanges() blocks until files are written, moved or removed
+and returns their paths. Changes are gathered until the directory
+stays quiet for a moment, so that one save gives one batch
+*/
+class DirectoryWatcher : private boost::noncopyable {
+public:
+	DirectoryWatcher(path directory);
+	~DirectoryWatcher();
+
+	// false if the platform has no support or the directory can't be watched
+	bool isWatching() const;
+	set<path> waitForChanges();
+
+private:
+	path m_directory;
+	int m_fd;
+	int m_wd;
+};
+
+#endif
@@ -2,13 +2,22 @@
 #define _JACK_ANALYZER_H
 
 #include <string>
+#include <iostream>
 #include <boost/filesystem.hpp>
 #include "jack_tokenizer.h"
 #include "compilation_engine.h"
 
 class JackAnalyzer {
 public:
-	JackAnalyzer(boost::filesystem::path p, std::string jackcode) :m_jtok(jackcode), m_compEngine(m_jtok, p) {}
+	/**
+	The XML goes to output, or when it's null,
+	to the .xml file next to the source p
+	*/
+	JackAnalyzer(boost::filesystem::path p, SourceView jackcode, std::ostream &diag = std::cerr,
+		std::ostream *output = 0) :m_jtok(jackcode), m_compEngine(m_jtok, p, diag, output) {}
+
+	// no error was reported
+	bool succeeded() { return !m_compEngine.hasFailed(); }
 
 private:
 	JackTokenizer m_jtok;
@@ -2,8 +2,8 @@
 
 using namespace std;
 
-JackCompilationEngine::JackCompilationEngine(JackTokenizer &jtok, boost::filesystem::path p, map<string,SubroutineInfo> ref_methods)
-	:CompilationEngine(jtok), m_VMOutput(p), m_externSubroutine_params(0), m_ifCounter(0), m_whileCounter(0)
+JackCompilationEngine::JackCompilationEngine(JackTokenizer &jtok, boost::filesystem::path p, map<string,SubroutineInfo> ref_methods, const ProgramIndex *index, ostream &diag, ostream *vm_out, const CodegenOptions &options)
+	:CompilationEngine(jtok), m_options(options), m_VMOutput(p, vm_out, options.format), m_diag(diag), m_failed(false), m_index(index), m_externSubroutine_params(0), m_ifCounter(0), m_whileCounter(0), m_stringCounter(0), m_isConstant(false), m_constantValue(0)
 {
 	// initialize internal vars
 	m_op.push_back( '+' );
@@ -46,17 +46,48 @@ JackCompilationEngine::JackCompilationEngine(JackTokenizer &jtok, boost::filesys
 	m_fileName = p.filename().stem().string();
 
 	// BEFORE we compile this class, we need to retrieve infos about methods of this class
-	m_classSubroutine_params = ref_methods;
+	for (map<string, SubroutineInfo>::iterator it = ref_methods.begin(), it_end = ref_methods.end(); it != it_end; ++it)
+	{
+		m_classSubroutine_params.insert( pair<Atom, SubroutineInfo>(m_jtok.interner().intern(it->first), it->second) );
+	}
 
 	// virtuals functions statically resolved in construct/destruct
 	JackCompilationEngine::compileClass(); 
 
+	if (m_options.peephole != 0)
+	{
+		PeepholeOptimizer optimizer(m_options.peephole);
+		vector<VMCode> &subroutines = m_VMOutput.subroutines();
+
+		for (vector<VMCode>::iterator it = subroutines.begin(), it_end = subroutines.end(); it != it_end; ++it)
+		{
+			optimizer.run( *it );
+		}
+	}
+
 	m_VMOutput.close();
 }
 
 map<string, SubroutineInfo> JackCompilationEngine::getMethodList()
 {
-	return m_classSubroutine_params;
+	map<string, SubroutineInfo> methods;
+
+	for (map<Atom, SubroutineInfo>::iterator it = m_classSubroutine_params.begin(), it_end = m_classSubroutine_params.end(); it != it_end; ++it)
+	{
+		methods.insert( pair<string, SubroutineInfo>(m_jtok.interner().str(it->first), it->second) );
+	}
+
+	return methods;
+}
+
+bool JackCompilationEngine::hasFailed()
+{
+	return m_failed;
+}
+
+map<string, SubroutineInfo> JackCompilationEngine::getExternDependencies()
+{
+	return m_externDependencies;
 }
 
 void JackCompilationEngine::compileClass()
@@ -103,16 +134,22 @@ void JackCompilationEngine::compileClass()
 		m_jtok.advance();
 		inspectSymbol('}');
 	}
+	catch (const LexicalError& e)
+	{
+		m_diag << JackError(e.message(), m_fileName, e.line(), e.column()).what() << endl;
+		m_failed = true;
+	}
 	catch (const exception& e)
 	{
-		cerr << e.what() << endl;
+		m_diag << e.what() << endl;
+		m_failed = true;
 	}
 }
 
 void JackCompilationEngine::compileClassVarDec()
 {
 	// store info for the symbol table
-	string idName, idType;
+	Atom idType, idName;
 	KIND idKind;
 
 	// check ('static' | 'field')
@@ -127,21 +164,14 @@ void JackCompilationEngine::compileClassVarDec()
 	inspectType();
 
 	// get the type
-	if ( m_jtok.tokenType() == TOK_KEYWORD )
-	{
-		idType = keyword_to_string( m_jtok.keyword() );
-	}
-	else
-	{
-		idType = m_jtok.identifier();
-	}
+	idType = typeAtom();
 
 	// check varName
 	m_jtok.advance();
 	inspectVarName();
 
 	// get the name
-	idName = m_jtok.identifier();
+	idName = m_jtok.identifierAtom();
 
 	// insert a new identifier
 	m_symTab.Define(idName, idType, idKind);
@@ -169,7 +199,7 @@ void JackCompilationEngine::compileClassVarDec()
 			inspectVarName();
 
 			// get the name
-			idName = m_jtok.identifier();
+			idName = m_jtok.identifierAtom();
 
 			// insert another identifier
 			m_symTab.Define(idName, idType, idKind);
@@ -242,6 +272,7 @@ void JackCompilationEngine::compileSubroutine()
 
 	// get the subName
 	m_currentSubroutine_name = m_jtok.identifier();
+	Atom subr_atom = m_jtok.identifierAtom();
 
 	// check '('
 	m_jtok.advance();
@@ -257,7 +288,7 @@ void JackCompilationEngine::compileSubroutine()
 
 	// store infos (TYPE, KIND, number of ARGUMENTS) from this new subroutine 
 	SubroutineInfo subInfo(m_currentSubroutine_type, m_currentSubroutine_kind, m_symTab.VarCount(K_ARG));
-	m_classSubroutine_params.insert( pair<string, SubroutineInfo>(m_currentSubroutine_name, subInfo) );
+	m_classSubroutine_params.insert( pair<Atom, SubroutineInfo>(subr_atom, subInfo) );
 	
 	// check subroutineBody
 
@@ -315,7 +346,7 @@ void JackCompilationEngine::compileSubroutine()
 void JackCompilationEngine::compileParameterList()
 {
 	// store info for the symbol table
-	string idName, idType;
+	Atom idType, idName;
 	
 	pair<TYPE_TOKEN, string> tok_val = m_jtok.peek();
 
@@ -331,21 +362,14 @@ void JackCompilationEngine::compileParameterList()
 	inspectType();
 
 	// get the type
-	if ( m_jtok.tokenType() == TOK_KEYWORD )
-	{
-		idType = keyword_to_string( m_jtok.keyword() );
-	}
-	else
-	{
-		idType = m_jtok.identifier();
-	}
+	idType = typeAtom();
 
 	// check varName
 	m_jtok.advance();
 	inspectVarName();
 
 	// get the name
-	idName = m_jtok.identifier();
+	idName = m_jtok.identifierAtom();
 
 	// insert a new argument id
 	m_symTab.Define(idName, idType, K_ARG);
@@ -373,21 +397,14 @@ void JackCompilationEngine::compileParameterList()
 			inspectType();
 
 			// get the type
-			if ( m_jtok.tokenType() == TOK_KEYWORD )
-			{
-				idType = keyword_to_string( m_jtok.keyword() );
-			}
-			else
-			{
-				idType = m_jtok.identifier();
-			}
+			idType = typeAtom();
 				
 			// check varname
 			m_jtok.advance();
 			inspectVarName();
 
 			// get the name
-			idName = m_jtok.identifier();
+			idName = m_jtok.identifierAtom();
 
 			// insert another argument id
 			m_symTab.Define(idName, idType, K_ARG);
@@ -402,7 +419,7 @@ void JackCompilationEngine::compileParameterList()
 void JackCompilationEngine::compileVarDec()
 {
 	// store info for the symbol table
-	string idName, idType;
+	Atom idType, idName;
 	
 	// check 'var'
 	m_jtok.advance();
@@ -413,21 +430,14 @@ void JackCompilationEngine::compileVarDec()
 	inspectType();
 
 	// get the type
-	if ( m_jtok.tokenType() == TOK_KEYWORD )
-	{
-		idType = keyword_to_string( m_jtok.keyword() );
-	}
-	else
-	{
-		idType = m_jtok.identifier();
-	}
+	idType = typeAtom();
 
 	// check varName
 	m_jtok.advance();
 	inspectVarName();
 
 	// get the name
-	idName = m_jtok.identifier();
+	idName = m_jtok.identifierAtom();
 
 	// insert a new local id
 	m_symTab.Define(idName, idType, K_VAR);
@@ -456,7 +466,7 @@ void JackCompilationEngine::compileVarDec()
 			inspectVarName();
 
 			// get the name
-			idName = m_jtok.identifier();
+			idName = m_jtok.identifierAtom();
 
 			// insert another local id
 			m_symTab.Define(idName, idType, K_VAR);
@@ -545,9 +555,10 @@ void JackCompilationEngine::compileLet()
 	m_jtok.advance();
 	inspectVarName();
 
-	string str = m_jtok.identifier();
-	KIND var_kind = m_symTab.KindOf( str );
-	int var_index = m_symTab.IndexOf( str );
+	Atom var_name = m_jtok.identifierAtom();
+	Symbol var = m_symTab.resolve( var_name );
+	KIND var_kind = var.kind;
+	int var_index = var.index;
 
 	// varname can be an array, check varname[expr]
 	pair<TYPE_TOKEN, string> tok_val = m_jtok.peek();
@@ -807,33 +818,27 @@ void JackCompilationEngine::compileSubroutineCall()
 		inspectSubroutineName();
 		
 		subr_name = m_jtok.identifier();
+		Atom subr_atom = m_jtok.identifierAtom();
 
 		// check '('
 		m_jtok.advance();
 		inspectSymbol('(');	
 
-		// if the identifier is a varName, we need to push his value to the heap before
-		// evaluating the expression in parenthesis
-		if ( m_symTab.TypeOf( id_name ) != "" )
-		{
-			// push identifier before any other value
-			KIND kind = m_symTab.KindOf( id_name );
-			int idx = m_symTab.IndexOf( id_name );
-			pushIdentifier( kind, idx );
-		}
-		else
-		{
-			m_VMOutput.writePush( SEG_POINTER, 0 );
-		}
+		// a direct call is made on the current object
+		m_VMOutput.writePush( SEG_POINTER, 0 );
+
+		// check expressionList, the arguments are counted from the declaration
+		int outer_params = m_externSubroutine_params;
 
-		// check expressionList
 		compileExpressionList();
+
+		m_externSubroutine_params = outer_params;
 		
 
 		// At this point, the subroutine MUST be defined in the current class
-		map<string, SubroutineInfo>::iterator subr_it, subr_it_end;
+		map<Atom, SubroutineInfo>::iterator subr_it, subr_it_end;
 
-		subr_it = m_classSubroutine_params.find( subr_name );
+		subr_it = m_classSubroutine_params.find( subr_atom );
 		subr_it_end = m_classSubroutine_params.end();
 
 		if (subr_it != subr_it_end)
@@ -846,18 +851,8 @@ void JackCompilationEngine::compileSubroutineCall()
 			{
 				subr_nArgs += 1;
 			}
-		
-			// if the identifier is a varName, we write his type instead of his value
-			if ( m_symTab.TypeOf( id_name ) != "" )
-			{	
-				string type = m_symTab.TypeOf( id_name );
-				m_VMOutput.writeCall(string( type + "." + subr_name ), subr_nArgs);
-			}
-			// if it's a direct call, don't forget to push 'this'
-			else
-			{
-				m_VMOutput.writeCall(string( m_className + "." + subr_name ), subr_nArgs);
-			}
+
+			m_VMOutput.writeCall(string( m_className + "." + subr_name ), subr_nArgs);
 		}
 
 		// check ')'
@@ -871,6 +866,7 @@ void JackCompilationEngine::compileSubroutineCall()
 		inspectIdentifier();
 
 		id_name = m_jtok.identifier();
+		Atom id_atom = m_jtok.identifierAtom();
 
 		// check '.'
 		m_jtok.advance();
@@ -881,6 +877,8 @@ void JackCompilationEngine::compileSubroutineCall()
 		inspectSubroutineName();
 
 		subr_name = m_jtok.identifier();
+		int subr_line = m_jtok.getCurrentLine();
+		int subr_column = m_jtok.getCurrentColumn();
 
 		// check '('
 		m_jtok.advance();
@@ -888,46 +886,116 @@ void JackCompilationEngine::compileSubroutineCall()
 
 		// if the identifier is a varName, we need to push his value to the heap before
 		// evaluating the expression in parenthesis
-		if ( m_symTab.TypeOf( id_name ) != "" )
+		Symbol receiver = m_symTab.resolve( id_atom );
+
+		if ( receiver.found() )
 		{
 			// push identifier before any other value
-			KIND kind = m_symTab.KindOf( id_name );
-			int idx = m_symTab.IndexOf( id_name );
-			pushIdentifier( kind, idx );
+			pushIdentifier( receiver.kind, receiver.index );
 		}
 
-		// check expressionList
+		// check expressionList, nested calls have their own counter
+		int outer_params = m_externSubroutine_params;
+		m_externSubroutine_params = 0;
+
 		compileExpressionList();
 
+		int nArgs = m_externSubroutine_params;
+		m_externSubroutine_params = outer_params;
+
 
 		// if the identifier is a varName, we write his type instead of his value
-		if ( m_symTab.TypeOf( id_name ) != "" )
+		if ( receiver.found() )
 		{
-			string type = m_symTab.TypeOf( id_name );
-			m_VMOutput.writeCall(string( type + "." + subr_name ), m_externSubroutine_params + 1);
+			const string &type = m_jtok.interner().str( receiver.type );
+			checkExternalCall( type, subr_name, true, nArgs, subr_line, subr_column );
+			m_VMOutput.writeCall(string( type + "." + subr_name ), nArgs + 1);
 		}
 		// if it's a class, just write the vm call
 		else
 		{
-			m_VMOutput.writeCall(string( id_name + "." + subr_name ), m_externSubroutine_params);
+			checkExternalCall( id_name, subr_name, false, nArgs, subr_line, subr_column );
+			m_VMOutput.writeCall(string( id_name + "." + subr_name ), nArgs);
 		}
 
 		// check ')'
 		m_jtok.advance();
 		inspectSymbol(')');
 	}
+}
+
+Atom JackCompilationEngine::typeAtom()
+{
+	if ( m_jtok.tokenType() == TOK_KEYWORD )
+	{
+		return m_jtok.interner().intern( keyword_to_string( m_jtok.keyword() ) );
+	}
 
-	// reset args counter for non-class subroutines
-	m_externSubroutine_params = 0;
+	return m_jtok.identifierAtom();
+}
+
+void JackCompilationEngine::checkExternalCall( const string &className, const string &subr_name, bool onObject, int nArgs, int line, int column )
+{
+	if ( m_index == 0 )
+		return;
+
+	string full_name = className + "." + subr_name;
+
+	// classes outside of the program (OS, ...) can't be checked,
+	// the call only relies on their absence
+	if ( !m_index->hasClass( className ) )
+	{
+		m_externDependencies[full_name] = SubroutineInfo();
+		return;
+	}
+
+	const SubroutineInfo *subr = m_index->find( className, subr_name );
+
+	if ( subr == 0 )
+	{
+		throw JackError("\"" + full_name + "\" is not defined", m_fileName, line, column);
+	}
+
+	if ( onObject && subr->kind != "method" )
+	{
+		throw JackError("\"" + full_name + "\" is a " + subr->kind + ", it can't be called on an object", m_fileName, line, column);
+	}
+
+	if ( !onObject && subr->kind == "method" )
+	{
+		throw JackError("\"" + full_name + "\" is a method, it must be called on an object", m_fileName, line, column);
+	}
+
+	if ( subr->nArgs != nArgs )
+	{
+		ostringstream oss;
+		oss << "\"" << full_name << "\" expects " << subr->nArgs << " argument(s), " << nArgs << " given";
+		throw JackError(oss.str(), m_fileName, line, column);
+	}
+
+	m_externDependencies[full_name] = *subr;
+}
+
+/* Jack integers are 16-bit two's complement */
+static int wrap16(int value)
+{
+	value &= 0xFFFF;
+
+	return value >= 0x8000 ? value - 0x10000 : value;
 }
 
 void JackCompilationEngine::compileExpression()
 {
 	// TODO : vrifier leur type et lever une exception de type InvalidType s'ils sont diffrents du type entier 'int'
 
+	size_t start = m_VMOutput.mark();
+
 	// check term
 	compileTerm();
 
+	bool constant = m_isConstant;
+	int value = m_constantValue;
+
 	// check (op term)*
 	for (;;)
 	{
@@ -941,9 +1009,35 @@ void JackCompilationEngine::compileExpression()
 			m_jtok.advance();
 			inspectOp();
 
+			size_t operand = m_VMOutput.mark();
+
 			// check term
 			compileTerm();
 
+			// both terms are constant : the result replaces their code
+			int result;
+			if (constant && m_isConstant && foldOperation( val[0], value, m_constantValue, result ))
+			{
+				m_VMOutput.truncate( start );
+				pushConstant( result );
+
+				value = result;
+				continue;
+			}
+
+			bool constantLeft = constant;
+			constant = false;
+
+			if (m_options.reduceStrength)
+			{
+				if (val == "*" && constantLeft && reduceMultiply( start, operand, true, value ))
+					continue;
+				if (val == "*" && m_isConstant && reduceMultiply( start, operand, false, m_constantValue ))
+					continue;
+				if (val == "/" && m_isConstant && reduceDivide( operand, m_constantValue ))
+					continue;
+			}
+
 			// write VM operations in accordance to the RPN
 			// i.e. term1 term2 op
 			if (val == "*")
@@ -964,6 +1058,9 @@ void JackCompilationEngine::compileExpression()
 			break;
 		}	
 	}
+
+	m_isConstant = constant;
+	m_constantValue = value;
 }
 
 void JackCompilationEngine::compileTerm()
@@ -971,6 +1068,9 @@ void JackCompilationEngine::compileTerm()
 	m_jtok.advance();
 
 	TYPE_TOKEN tt = m_jtok.tokenType();
+	size_t start = m_VMOutput.mark();
+	bool constant = false;
+	int value = 0;
 	
 	// check integer
 	if ( tt == TOK_INT_CONST )
@@ -978,22 +1078,21 @@ void JackCompilationEngine::compileTerm()
 		inspectIntegerConstant();
 
 		m_VMOutput.writePush(SEG_CONST, m_jtok.intVal());
+
+		constant = true;
+		value = m_jtok.intVal();
 	}
 	// check string
 	else if ( tt == TOK_STRING_CONST )
 	{
 		//inspectStringConstant();
-		// alloc a pointer with string.size() elements
-		string str = m_jtok.stringVal();
-		int size = str.size();
-
-		m_VMOutput.writePush(SEG_CONST, size);
-		m_VMOutput.writeCall("String.new", 1);
-		// push elements char by char
-		for (int i = 0; i < size; i++)
+		if (m_options.poolStrings)
+		{
+			pushPooledString( m_jtok.stringVal() );
+		}
+		else
 		{
-			m_VMOutput.writePush(SEG_CONST, str[i]);
-			m_VMOutput.writeCall("String.appendChar", 2);
+			buildString( m_jtok.stringVal() );
 		}
 	}
 	// check keyword constant
@@ -1010,11 +1109,17 @@ void JackCompilationEngine::compileTerm()
 			{
 				m_VMOutput.writePush(SEG_CONST, 0);
 				m_VMOutput.writeArithmetic(C_NOT);
+
+				constant = true;
+				value = -1;
 				break;
 			}
 		case KW_NULL:
 		case KW_FALSE:
 			m_VMOutput.writePush(SEG_CONST, 0);
+
+			constant = true;
+			value = 0;
 			break;
 		}
 	}
@@ -1033,6 +1138,9 @@ void JackCompilationEngine::compileTerm()
 			// check ')'
 			m_jtok.advance();
 			inspectSymbol( ')' );
+
+			constant = m_isConstant;
+			value = m_constantValue;
 		}
 		// check unaryOp
 		else if ( sym == '-' || sym == '~' )
@@ -1042,7 +1150,18 @@ void JackCompilationEngine::compileTerm()
 			// check term
 			compileTerm();
 
-			m_VMOutput.writeArithmetic( char_to_unaryOp( sym ));
+			if (m_isConstant)
+			{
+				constant = true;
+				value = wrap16( sym == '-' ? -m_constantValue : ~m_constantValue );
+
+				m_VMOutput.truncate( start );
+				pushConstant( value );
+			}
+			else
+			{
+				m_VMOutput.writeArithmetic( char_to_unaryOp( sym ));
+			}
 		}
 	}
 	else if ( tt == TOK_IDENTIFIER )
@@ -1054,9 +1173,10 @@ void JackCompilationEngine::compileTerm()
 		{
 			inspectVarName();
 
-			string str = m_jtok.identifier();
-			KIND var_kind = m_symTab.KindOf( str );
-			int var_index = m_symTab.IndexOf( str );
+			Atom var_name = m_jtok.identifierAtom();
+			Symbol var = m_symTab.resolve( var_name );
+			KIND var_kind = var.kind;
+			int var_index = var.index;
 
 			// check '['
 			m_jtok.advance();
@@ -1087,14 +1207,226 @@ void JackCompilationEngine::compileTerm()
 		{
 			inspectVarName();
 
-			string str = m_jtok.identifier();
-			KIND var_kind = m_symTab.KindOf( str );
-			int var_index = m_symTab.IndexOf( str );
+			Atom var_name = m_jtok.identifierAtom();
+			Symbol var = m_symTab.resolve( var_name );
+			KIND var_kind = var.kind;
+			int var_index = var.index;
 			
 			// write VM 
 			pushIdentifier(var_kind, var_index);
 		}
 	}
+
+	m_isConstant = constant;
+	m_constantValue = value;
+}
+
+bool JackCompilationEngine::foldOperation(char op, int left, int right, int &result)
+{
+	switch ( op )
+	{
+	case '+':
+		result = left + right;
+		break;
+	case '-':
+		result = left - right;
+		break;
+	case '*':
+		// Math.multiply keeps the low 16 bits
+		result = left * right;
+		break;
+	case '/':
+		// Math.divide rounds toward zero; its own overflow is left to run time
+		if (right == 0 || left == -32768)
+			return false;
+		result = left / right;
+		break;
+	case '&':
+		result = left & right;
+		break;
+	case '|':
+		result = left | right;
+		break;
+	case '<':
+		result = left < right ? -1 : 0;
+		break;
+	case '>':
+		result = left > right ? -1 : 0;
+		break;
+	case '=':
+		result = left == right ? -1 : 0;
+		break;
+	default:
+		return false;
+	}
+
+	result = wrap16( result );
+	return true;
+}
+
+void JackCompilationEngine::buildString(const string &str)
+{
+	// alloc a pointer with string.size() elements
+	int size = str.size();
+
+	m_VMOutput.writePush(SEG_CONST, size);
+	m_VMOutput.writeCall("String.new", 1);
+	// push elements char by char
+	for (int i = 0; i < size; i++)
+	{
+		m_VMOutput.writePush(SEG_CONST, str[i]);
+		m_VMOutput.writeCall("String.appendChar", 2);
+	}
+}
+
+void JackCompilationEngine::pushPooledString(const string &str)
+{
+	// every static of the class is declared before the first subroutine
+	map<string, int>::iterator it = m_stringPool.find( str );
+	if (it == m_stringPool.end())
+	{
+		it = m_stringPool.insert( pair<string, int>(str, (int)m_stringPool.size()) ).first;
+	}
+
+	int index = m_symTab.VarCount( K_STATIC ) + it->second;
+	int local_string_counter = m_stringCounter++;
+
+	// statics start at 0 (null) : the string is built on its first use
+	m_VMOutput.writePush(SEG_STATIC, index);
+	m_VMOutput.writeIf( "STRING_READY", local_string_counter );
+	buildString( str );
+	m_VMOutput.writePop(SEG_STATIC, index);
+	m_VMOutput.writeLabel( "STRING_READY", local_string_counter );
+	m_VMOutput.writePush(SEG_STATIC, index);
+}
+
+// longest code replacing a call to Math.multiply, which costs hundreds of cycles
+static const int MAX_REDUCED_LENGTH = 24;
+
+/* x * 2^k : k doublings, 4 instructions each (x * 8 -> 12)
+ * x * n : n - 1 additions, 2 instructions each plus the store of x
+ */
+static int multiply_length(int factor, int &doublings)
+{
+	int n = factor < 0 ? -factor : factor;
+	int length = 2 * n;
+
+	doublings = 0;
+	while ((1 << doublings) < n)
+		doublings++;
+
+	if ((1 << doublings) == n && 4 * doublings < length)
+		length = 4 * doublings;
+	else
+		doublings = 0;
+
+	return factor < 0 ? length + 1 : length;
+}
+
+bool JackCompilationEngine::reduceMultiply(size_t start, size_t operand, bool constantLeft, int factor)
+{
+	int doublings;
+	if (factor == -32768 || multiply_length( factor, doublings ) > MAX_REDUCED_LENGTH)
+		return false;
+
+	// only the other operand is left, in [start, end)
+	if (constantLeft)
+		m_VMOutput.erase( start, operand );
+	else
+		m_VMOutput.truncate( operand );
+
+	int n = factor < 0 ? -factor : factor;
+	size_t end = m_VMOutput.mark();
+
+	// a single push can be done again, any other operand is stored in temp 1
+	VMInstruction source( OP_PUSH, (unsigned char)SEG_TEMP, NO_ATOM, 1 );
+	bool stored = true;
+
+	if (end - start == 1 && m_VMOutput.instruction(start).opcode == OP_PUSH)
+	{
+		source = m_VMOutput.instruction(start);
+		stored = false;
+	}
+
+	if (n == 0)
+	{
+		// the operand is still evaluated for its side effects
+		if (stored)
+			m_VMOutput.writePop(SEG_TEMP, 1);
+		else
+			m_VMOutput.truncate( start );
+
+		m_VMOutput.writePush(SEG_CONST, 0);
+		return true;
+	}
+
+	if (n > 1 && stored)
+		m_VMOutput.writePop(SEG_TEMP, 1);
+	else if (n > 1)
+		m_VMOutput.truncate( start );
+
+	if (doublings > 0)
+	{
+		m_VMOutput.writePush(source.segment(), source.index);
+		m_VMOutput.writePush(source.segment(), source.index);
+		m_VMOutput.writeArithmetic(C_ADD);
+
+		for (int i = 1; i < doublings; i++)
+		{
+			m_VMOutput.writePop(SEG_TEMP, 1);
+			m_VMOutput.writePush(SEG_TEMP, 1);
+			m_VMOutput.writePush(SEG_TEMP, 1);
+			m_VMOutput.writeArithmetic(C_ADD);
+		}
+	}
+	else if (n > 1)
+	{
+		m_VMOutput.writePush(source.segment(), source.index);
+
+		for (int i = 1; i < n; i++)
+		{
+			m_VMOutput.writePush(source.segment(), source.index);
+			m_VMOutput.writeArithmetic(C_ADD);
+		}
+	}
+
+	if (factor < 0)
+		m_VMOutput.writeArithmetic(C_NEG);
+
+	return true;
+}
+
+bool JackCompilationEngine::reduceDivide(size_t operand, int divisor)
+{
+	// the VM has no shift : only x / 1 and x / -1 are cheaper than Math.divide
+	if (divisor != 1 && divisor != -1)
+		return false;
+
+	m_VMOutput.truncate( operand );
+
+	if (divisor == -1)
+		m_VMOutput.writeArithmetic(C_NEG);
+
+	return true;
+}
+
+void JackCompilationEngine::pushConstant(int value)
+{
+	// constants are 0..32767, the others come from neg (or not for -32768)
+	if (value >= 0)
+	{
+		m_VMOutput.writePush(SEG_CONST, value);
+	}
+	else if (value == -32768)
+	{
+		m_VMOutput.writePush(SEG_CONST, 32767);
+		m_VMOutput.writeArithmetic(C_NOT);
+	}
+	else
+	{
+		m_VMOutput.writePush(SEG_CONST, -value);
+		m_VMOutput.writeArithmetic(C_NEG);
+	}
 }
 
 void JackCompilationEngine::compileExpressionList()
@@ -1338,6 +1670,12 @@ void JackCompilationEngine::inspectType()
 
 void JackCompilationEngine::pushIdentifier(KIND kind, int index)
 {
+	// the identifier isn't in the symbol table
+	if (kind == K_NONE)
+	{
+		throw JackError("Undeclared variable", m_fileName, m_jtok.getCurrentLine(), m_jtok.getCurrentColumn());
+	}
+
 	// write VM 
 	if (kind == K_ARG)
 	{
@@ -1373,6 +1711,12 @@ void JackCompilationEngine::pushIdentifier(KIND kind, int index)
 
 void JackCompilationEngine::popIdentifier(KIND kind, int index)
 {
+	// the identifier isn't in the symbol table
+	if (kind == K_NONE)
+	{
+		throw JackError("Undeclared variable", m_fileName, m_jtok.getCurrentLine(), m_jtok.getCurrentColumn());
+	}
+
 	// write VM 
 	if (kind == K_ARG)
 	{
@@ -3,24 +3,66 @@
 
 #include <string>
 #include <map>
+#include <iostream>
 #include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "jack_tokenizer.h"
+#include "declaration_scanner.h"
 #include "compilation_engine.h"
+#include "program_index.h"
 
 class JackCompiler {
 public:
-	JackCompiler(boost::filesystem::path p, std::string jackcode) : m_temp_jtok(jackcode), m_temp_engine(m_temp_jtok, p)
+	/**
+	The VM code goes to output, or when it's null,
+	to the .vm (.vmb) file next to the source p
+	*/
+	JackCompiler(boost::filesystem::path p, SourceView jackcode, const ProgramIndex *index = 0,
+		std::ostream &diag = std::cerr, std::ostream *output = 0, const CodegenOptions &options = CodegenOptions())
+		: m_ownScan(new ScannedFile(jackcode)), m_scanned(*m_ownScan)
 	{
-		map<string, SubroutineInfo> methodList = m_temp_engine.getMethodList();
+		compile(p, index, diag, output, options);
+	}
 
-		// final Pass
-		JackTokenizer m_final_jtok(jackcode);
-		JackCompilationEngine final_pass(m_final_jtok, p, methodList);
+	/**
+	Same, for a file already lexed and scanned (when the
+	program index was built) : its tokens are replayed
+	*/
+	JackCompiler(boost::filesystem::path p, ScannedFile &scanned, const ProgramIndex *index = 0,
+		std::ostream &diag = std::cerr, std::ostream *output = 0, const CodegenOptions &options = CodegenOptions())
+		: m_scanned(scanned)
+	{
+		compile(p, index, diag, output, options);
 	}
 
+	// the .vm is complete, no error was reported
+	bool succeeded() { return m_succeeded; }
+	string getClassName() { return m_scanned.getClassName(); }
+	map<string, SubroutineInfo> getMethodList() { return m_scanned.getMethodList(); }
+	// map< Class.subroutine, signature > this file relied on
+	map<string, SubroutineInfo> getDependencies() { return m_dependencies; }
+
 private:
-	JackTokenizer m_temp_jtok;
-	JackCompilationEngine m_temp_engine;
+	boost::scoped_ptr<ScannedFile> m_ownScan;
+	// 1st pass : the tokens and the subroutine signatures only
+	ScannedFile &m_scanned;
+	bool m_succeeded;
+	map<string, SubroutineInfo> m_dependencies;
+
+	void compile(boost::filesystem::path p, const ProgramIndex *index,
+		std::ostream &diag, std::ostream *output, const CodegenOptions &options)
+	{
+		map<string, SubroutineInfo> methodList = m_scanned.getMethodList();
+
+		// final Pass : the source is lexed only once,
+		// we just replay the same token stream
+		JackTokenizer &jtok = m_scanned.tokenizer();
+		jtok.rewind();
+		JackCompilationEngine final_pass(jtok, p, methodList, index, diag, output, options);
+
+		m_succeeded = !final_pass.hasFailed();
+		m_dependencies = final_pass.getExternDependencies();
+	}
 };
 
 #endif
@@ -0,0 +1,105 @@
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include "jack_library.h"
+#include "jack_compiler.h"
+#include "jack_analyzer.h"
+
+using namespace std;
+
+/* the path only names the unit (error messages, ...),
+it's never opened
+*/
+static boost::filesystem::path unit_path(const string &name)
+{
+	return boost::filesystem::path(name + ".jack");
+}
+
+typedef boost::shared_ptr<ScannedFile> scanned_ptr;
+
+static CompileResult make_result(string name, JackCompiler &jcompiler, ostringstream &output, ostringstream &diag)
+{
+	CompileResult result;
+	result.name = name;
+	result.output = output.str();
+	result.diagnostics = diag.str();
+	result.succeeded = jcompiler.succeeded();
+
+	return result;
+}
+
+CompileResult compile_source(string name, SourceView jackcode, const ProgramIndex *index, const CodegenOptions &options)
+{
+	ostringstream output, diag;
+	JackCompiler jcompiler(unit_path(name), jackcode, index, diag, &output, options);
+
+	return make_result(name, jcompiler, output, diag);
+}
+
+// lexes and scans a unit once, for the index and then the final pass
+static void scan_unit(const SourceUnit *unit, ProgramIndex *index, scanned_ptr *scanned)
+{
+	scanned->reset( new ScannedFile(unit->second) );
+	index->addFile(**scanned);
+}
+
+static void compile_unit(const SourceUnit *unit, ScannedFile *scanned, const ProgramIndex *index,
+	const CodegenOptions *options, CompileResult *result)
+{
+	ostringstream output, diag;
+	JackCompiler jcompiler(unit_path(unit->first), *scanned, index, diag, &output, *options);
+
+	*result = make_result(unit->first, jcompiler, output, diag);
+}
+
+vector<CompileResult> compile_program(const vector<SourceUnit> &units, ThreadPool *pool, const CodegenOptions &options)
+{
+	ProgramIndex index;
+	vector<scanned_ptr> scanned(units.size());
+	vector<CompileResult> results(units.size());
+
+	if (!pool)
+	{
+		for (size_t i = 0; i < units.size(); i++)
+		{
+			scan_unit(&units[i], &index, &scanned[i]);
+		}
+
+		for (size_t i = 0; i < units.size(); i++)
+		{
+			compile_unit(&units[i], scanned[i].get(), &index, &options, &results[i]);
+		}
+
+		return results;
+	}
+
+	for (size_t i = 0; i < units.size(); i++)
+	{
+		pool->submit( boost::bind(&scan_unit, &units[i], &index, &scanned[i]) );
+	}
+
+	pool->wait();
+
+	for (size_t i = 0; i < units.size(); i++)
+	{
+		pool->submit( boost::bind(&compile_unit, &units[i], scanned[i].get(), &index, &options, &results[i]) );
+	}
+
+	pool->wait();
+
+	return results;
+}
+
+CompileResult analyze_source(string name, SourceView jackcode)
+{
+	ostringstream output, diag;
+	JackAnalyzer janalyse(unit_path(name), jackcode, diag, &output);
+
+	CompileResult result;
+	result.name = name;
+	result.output = output.str();
+	result.diagnostics = diag.str();
+	result.succeeded = janalyse.succeeded();
+
+	return result;
+}
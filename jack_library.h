@@ -0,0 +1,56 @@
+#ifndef _JACK_LIBRARY_H
+#define _JACK_LIBRARY_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "jack_tokenizer.h"
+#include "program_index.h"
+#include "thread_pool.h"
+#include "codegen_options.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+
+/**
+In-memory entry points, for programs embedding the compiler :
+sources are given as buffers, the generated code and the errors
+are returned as strings, nothing is read from or written to the disk.
+A unit is named like its file, without the ".jack" extension
+*/
+
+struct CompileResult {
+	string name;
+	// VM code, text or binary (XML for the analyzer), incomplete when it failed
+	string output;
+	// errors, one per line
+	string diagnostics;
+	bool succeeded;
+
+	CompileResult():succeeded(false) {}
+};
+
+typedef pair<string, SourceView> SourceUnit;
+
+/**
+Compiles one unit; when given, the index is used
+to check the calls to the other classes
+*/
+CompileResult compile_source(string name, SourceView jackcode, const ProgramIndex *index = 0,
+	const CodegenOptions &options = CodegenOptions());
+
+/**
+Compiles the units as the files of one directory : the
+signatures of every unit are indexed first. Results come
+in the same order as the units
+*/
+vector<CompileResult> compile_program(const vector<SourceUnit> &units, ThreadPool *pool = 0,
+	const CodegenOptions &options = CodegenOptions());
+
+/**
+Outputs the parse tree of one unit as XML
+*/
+CompileResult analyze_source(string name, SourceView jackcode);
+
+#endif
@@ -1,361 +1,343 @@
 #include <sstream>
-#include <cctype>
-#include <boost/lexical_cast.hpp>
 #include "jack_tokenizer.h"
+#include "char_scanner.h"
 
 using namespace std;
 
-JackTokenizer::JackTokenizer(string jackcode)
-	:m_jackStreamCode(jackcode)
+JackTokenizer::JackTokenizer(SourceView jackcode)
+	:m_begin(jackcode.begin()), m_cur(jackcode.begin()), m_end(jackcode.end()), m_index(-1),
+	m_hasError(false), m_errorLine(0), m_errorColumn(0)
 {
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_CLASS, "class") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_CONSTRUCTOR, "constructor") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_FUNCTION, "function") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_METHOD, "method") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_FIELD, "field") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_STATIC, "static") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_VAR, "var") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_INT, "int") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_CHAR, "char") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_BOOLEAN, "boolean") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_VOID, "void") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_TRUE, "true") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_FALSE, "false") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_NULL, "null") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_THIS, "this") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_LET, "let") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_DO, "do") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_IF, "if") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_ELSE, "else") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_WHILE, "while") );
-	m_keywords.insert( pair<TYPE_KEYWORD, string>(KW_RETURN, "return") );
-
-	m_symbols.push_back('{'); m_symbols.push_back('}');
-	m_symbols.push_back('('); m_symbols.push_back(')');
-	m_symbols.push_back('['); m_symbols.push_back(']');
-	m_symbols.push_back('.');
-	m_symbols.push_back(',');
-	m_symbols.push_back(';');
-	m_symbols.push_back('+');
-	m_symbols.push_back('-');
-	m_symbols.push_back('*');
-	m_symbols.push_back('/');
-	m_symbols.push_back('&');
-	m_symbols.push_back('|');
-	m_symbols.push_back('<');
-	m_symbols.push_back('>');
-	m_symbols.push_back('=');
-	m_symbols.push_back('~');
-
 	m_curLine = 1;
 	m_curCol = 1;
+
+	// lex the whole unit once, the engines then
+	// just move an index over the token array
+	for (;;)
+	{
+		Token tok = scan();
+		m_tokens.push_back(tok);
+
+		if (tok.type == TOK_EMPTY)
+			break;
+	}
+}
+
+const Token& JackTokenizer::current()
+{
+	// before the first advance(), there's no current token
+	if (m_index < 0)
+		return m_tokens.back();
+
+	return m_tokens[m_index];
+}
+
+SourceView JackTokenizer::view(const Token &tok)
+{
+	return SourceView(m_begin + tok.offset, tok.length);
 }
 
 int JackTokenizer::getCurrentLine()
 {
-	return m_curLine;
+	return current().line;
 }
 
 int JackTokenizer::getCurrentColumn()
 {
-	return m_curCol - m_currentToken.size();
+	return current().column;
 }
 
 bool JackTokenizer::hasMoreTokens()
 {
-	return m_jackStreamCode.good();
+	return m_index + 1 < (int)m_tokens.size() - 1;
 }
 
 void JackTokenizer::advance()
 {
-	// first, reset the current token to an empty string
-	m_currentToken = "";
-	
-	/* we read the code one character at a time
-		storing his value in a string buffer (stringbuf).
-		if the char is a separator (space or line feed),
-		we skip the function storing the current token as :
-		- an empty string if buffer_size = 0;
-		- the buffer value.
-		if the char is a symbol, it returns that value or
-		the concatened buffer.
-		if the char is equal to '/' then if it's followed by :
-		- another slash, we skipped chars
-		until we found a separator char ('\n'); it's a line comment
-		- a star, we try to reach the end of that block comment
-		and erase it from the stream
-		- something else, it's stored as a symbol
-	*/
-	char c;
-	stringbuf buffer;
+	// the last token (empty) is never passed
+	if (m_index + 1 < (int)m_tokens.size())
+		m_index++;
 
-	while ( hasMoreTokens() )
-	{
-		// read one char
-		c = m_jackStreamCode.get();
+	if (m_hasError && m_index == (int)m_tokens.size() - 1)
+		throw LexicalError( m_errorMessage, m_errorLine, m_errorColumn );
+}
 
-		m_curCol ++; // update pointer position
+void JackTokenizer::rewind()
+{
+	m_index = -1;
+}
 
-		string s = buffer.str();
+pair<TYPE_TOKEN, string> JackTokenizer::peek(int k)
+{
+	int idx = m_index + k;
+	if (idx >= (int)m_tokens.size())
+		idx = m_tokens.size() - 1;
+
+	const Token &tok = m_tokens[idx];
+	return pair<TYPE_TOKEN, string>(tok.type, view(tok).str());
+}
+
+Token JackTokenizer::scan()
+{
+	/* we walk the source text without copying anything :
+		a token is just an offset and a length in the source.
+		runs of separators, comment bodies and identifier
+		chars are skipped in bulk (see CharScanner).
+		separators (space, tab, CR, LF) are skipped.
+		if the char is equal to '/' then if it's followed by :
+		- another slash, we skip chars until the end
+		of the line; it's a line comment
+		- a star, we skip chars until we reach '*' '/'
+		- something else, it's a symbol
+		a symbol is a token on its own, a string constant
+		spans up to the closing quote and everything else
+		(keyword, identifier, integer) stops at the next
+		separator or symbol.
+	*/
+	while ( m_cur < m_end )
+	{
+		char c = *m_cur;
+		CHAR_CLASS cc = CharScanner::classOf(c);
 
 		// remove separators
-		// i could use isspace() => stdlib
-		if (c == ' ' || c == '\t' || c == '\n')
+		if (cc == CC_SEPARATOR)
 		{
-			if ( s.size() > 0 )
-			{
-				m_currentToken = s;
-				m_jackStreamCode.unget();
-				m_curCol--;
-				return;
-			}
-			else if (c == '\n')
-			{
-				m_curLine++; m_curCol = 1; // update pointer position
-			}
+			skipTo( CharScanner::skipSeparators(m_cur, m_end) );
 			continue;
 		}
 		// remove comments
-		if ( c == '/' )
+		if ( c == '/' && m_cur + 1 < m_end )
 		{
-			// read the next char
-			char next_c = m_jackStreamCode.get();
-
-			m_curCol++; // update pointer position
+			char next_c = m_cur[1];
 
 			if (next_c == '/')
 			{
-				// remove 1 line
-				char trash;
-				while ( hasMoreTokens() )
-				{
-					trash = m_jackStreamCode.get();
-
-					if (trash == '\n')
-					{
-						break;
-					}
-				}
-				m_curLine++; m_curCol = 1; // update pointer position
-
+				// remove 1 line (the '\n' is a separator)
+				skipTo( CharScanner::findChar(m_cur, m_end, '\n') );
 				continue;
 			}
 			else if (next_c == '*')
 			{
 				// remove all chars until we found '*/'
-				char c1=0;
-				char c2=0;
-				bool found = false;
-				while ( hasMoreTokens() )
+				const char *p = m_cur + 2;
+				for (;;)
 				{
-					c1 = c2;
-					c2 = m_jackStreamCode.get();
-
-					// update pointer position
-					if (c2 == '\n')
-					{
-						m_curLine++; m_curCol = 1;
-					}
-					else
-					{
-						m_curCol++;
-					}
+					p = CharScanner::findChar(p, m_end, '*');
+					if (p == m_end)
+						break;
 
-					if (c1 == '*' && c2 == '/')
+					p++;
+					if (p < m_end && *p == '/')
 					{
-						found = true;
+						p++;
 						break;
 					}
 				}
-				if (found) continue;
-			}
-			else
-			{
-				// put back next_c as the current char
-				m_jackStreamCode.unget();
-
-				m_curCol--; // update pointer position
+				skipTo( p );
+				continue;
 			}
 		}
 
+		// here starts a new token
+		const char *tok_begin = m_cur;
+		int tok_line = m_curLine;
+		int tok_col = m_curCol;
+
+		switch ( cc )
+		{
 		// there's a special issue with string constant,
 		// we need to parse the entire string inside the quotes
-		if ( c == '"' )
-		{
-			char next_c;
-			while ( hasMoreTokens() )
+		case CC_QUOTE:
+			m_cur++;
+			while ( m_cur < m_end )
 			{
-				next_c = m_jackStreamCode.get();
+				char next_c = *m_cur++;
+				m_curCol++;
 
-				// update pointer position
 				if (next_c == '\n')
 				{
-					cerr << "At line " << getCurrentLine() << ", column " << getCurrentColumn() << " : ";
-					cerr << "Escape character is not allowed in a string constant" << endl;
-					exit(-1);
-				}
-				else
-				{
-					m_curCol++;
+					return error( "Escape character is not allowed in a string constant", tok_line, tok_col );
 				}
 
 				if (next_c == '"')
 				{
-					break;
+					return Token(TOK_STRING_CONST, KW_UNKNOWN, tok_begin - m_begin, m_cur - tok_begin, tok_line, tok_col);
 				}
-
-				buffer.sputc(next_c);
 			}
 
-			m_currentToken = '"' + buffer.str() + '"';
+			return error( "A string constant is not closed", tok_line, tok_col );
 
-			return;
-		}
-		
-		// check if the character is a symbol
-		// i could use strpbrk http://www.cplusplus.com/reference/clibrary/cstring/strpbrk/
-		typedef vector<char>::iterator vec_it;
-		for (vec_it it = m_symbols.begin(), it_end = m_symbols.end();
-			it != it_end;
-			++it)
-		{
-			char symbol = *it;
-			if (c == symbol)
+		// a symbol is a token on its own
+		case CC_SYMBOL:
+			m_cur++;
+			m_curCol++;
+			return Token(TOK_SYMBOL, KW_UNKNOWN, tok_begin - m_begin, 1, tok_line, tok_col);
+
+		// keyword, identifier or integer : read until a separator, a symbol or a quote
+		default:
+			while ( m_cur < m_end )
 			{
-				if ( s.size() > 0 )
+				// letters, digits and '_' are skipped in bulk
+				m_cur = CharScanner::skipWordChars(m_cur, m_end);
+				if (m_cur == m_end)
 				{
-					m_currentToken = s;
-					// get the actual buffer value and
-					// return to the previous position in the stream (next time, we'll capture this symbol)
-					m_jackStreamCode.unget();
-
-					m_curCol--; // update pointer position
-
-					return;
+					break;
 				}
-				else
+
+				cc = CharScanner::classOf(*m_cur);
+				if (cc == CC_SEPARATOR || cc == CC_SYMBOL || cc == CC_QUOTE)
 				{
-					m_currentToken = c;
-					return;
+					break;
 				}
+				m_cur++;
 			}
-		}
+			m_curCol += m_cur - tok_begin;
 
-		// append the current char to the buffer
-		buffer.sputc(c);
+			return makeToken(tok_begin, m_cur - tok_begin, tok_line, tok_col);
+		}
 	}
+
+	// end of the source text
+	return Token(TOK_EMPTY, KW_UNKNOWN, m_cur - m_begin, 0, m_curLine, m_curCol);
 }
 
-pair<TYPE_TOKEN, string> JackTokenizer::peek()
+Token JackTokenizer::error(const string &message, int line, int column)
 {
-	// save the current token
-	string curToken = m_currentToken;
-	
-	advance();
+	m_hasError = true;
+	m_errorMessage = message;
+	m_errorLine = line;
+	m_errorColumn = column;
 
-	int rewind = m_currentToken.size();
+	return Token(TOK_EMPTY, KW_UNKNOWN, m_cur - m_begin, 0, line, column);
+}
 
-	for (int i=0; i < rewind; i++)
+void JackTokenizer::skipTo(const char *p)
+{
+	// update pointer position
+	const char *last_nl = 0;
+	int lines = CharScanner::countNewlines(m_cur, p, last_nl);
+
+	if (lines > 0)
 	{
-		m_jackStreamCode.unget();
-		m_curCol--;
+		m_curLine += lines;
+		m_curCol = 1 + (p - (last_nl + 1));
+	}
+	else
+	{
+		m_curCol += p - m_cur;
 	}
 
-	pair<TYPE_TOKEN, string> token_value(tokenType(), m_currentToken);
-
-	// restore the current token as if nothing happened
-	m_currentToken = curToken;
-
-	return token_value;
+	m_cur = p;
 }
 
 TYPE_TOKEN JackTokenizer::tokenType()
 {
-	if (m_currentToken.size() == 0)
-		return TOK_EMPTY;
-	
-	typedef map<TYPE_KEYWORD, string>::iterator keys_it;
-	typedef vector<char>::iterator sym_it;
-	
-	// check if the current token is:
+	return current().type;
+}
+
+Token JackTokenizer::makeToken(const char *begin, size_t length, int line, int column)
+{
+	unsigned int offset = begin - m_begin;
+	TYPE_TOKEN type;
+
+	// check if the token is:
 	// a keyword
-	for (keys_it it = m_keywords.begin(), it_end = m_keywords.end();
-		it != it_end;
-		++it)
-	{
-		if (m_currentToken == it->second)
-			return TOK_KEYWORD;
-	}
+	TYPE_KEYWORD kw = string_to_keyword(begin, length);
 
-	// a symbol
-	for (sym_it it = m_symbols.begin(), it_end = m_symbols.end();
-		it != it_end;
-		++it)
+	if (kw != KW_UNKNOWN)
+		type = TOK_KEYWORD;
+	// an integer constant
+	else if (CharScanner::classOf(begin[0]) == CC_DIGIT)
 	{
-		string str;
-		char c = *it;
-		str = c;
-		if (m_currentToken == str)
-			return TOK_SYMBOL;
+		for (size_t i = 1; i < length; i++)
+		{
+			if (CharScanner::classOf(begin[i]) != CC_DIGIT)
+				return error( "Invalid integer constant", line, column );
+		}
+		type = TOK_INT_CONST;
 	}
+	// it must be an identifier
+	else
+		type = TOK_IDENTIFIER;
 
-	// an integer constant
-	if (isdigit( m_currentToken[0] ))
-		return TOK_INT_CONST;
+	Token tok(type, kw, offset, length, line, column);
 
-	// a string constant
-	if (m_currentToken[0] == '"')
-		return TOK_STRING_CONST;
+	if (type == TOK_IDENTIFIER)
+		tok.atom = m_interner.intern(begin, length);
 
-	// it must be an identifier
-	return TOK_IDENTIFIER;
+	return tok;
 }
 
 TYPE_KEYWORD JackTokenizer::keyword()
 {
-	typedef map<TYPE_KEYWORD, string>::iterator keys_it;
-	for (keys_it it = m_keywords.begin(), it_end = m_keywords.end();
-		it != it_end;
-		++it)
-	{
-		if (m_currentToken == it->second)
-			return it->first;
-	}
-	throw TokenMismatch( "keyword" );
+	// the keyword was recognized at lex time
+	TYPE_KEYWORD kw = current().keyword;
+
+	if (kw != KW_UNKNOWN)
+		return kw;
+	else throw TokenMismatch( "keyword" );
 }
 
 char JackTokenizer::symbol()
 {
-	if (m_currentToken.size() == 1)
-		return m_currentToken[0];
+	SourceView tok = view(current());
+
+	if (tok.size == 1)
+		return tok.data[0];
 	else throw TokenMismatch( "symbol" );
 }
 
+Atom JackTokenizer::identifierAtom()
+{
+	Atom atom = current().atom;
+
+	if (atom != NO_ATOM)
+		return atom;
+	else throw TokenMismatch( "identifier" );
+}
+
+StringInterner& JackTokenizer::interner()
+{
+	return m_interner;
+}
+
 string JackTokenizer::identifier()
 {
-	if (m_currentToken.size() > 0)
-		return m_currentToken;
+	SourceView tok = view(current());
+
+	if (tok.size > 0)
+		return tok.str();
 	else throw TokenMismatch( "identifier" );
 }
 
 int JackTokenizer::intVal()
 {
+	SourceView tok = view(current());
+
+	if (tok.size == 0 || current().type != TOK_INT_CONST)
+		throw TokenMismatch( "integer" );
+
+	// only digits were lexed; past 32767 the value is just
+	// kept out of range, it's reported by the engines
 	int num = 0;
-	try
+	for (size_t i = 0; i < tok.size && num <= 32767; i++)
 	{
-		num = boost::lexical_cast<int>( m_currentToken );
-	}
-	catch (const boost::bad_lexical_cast &e)
-	{
-		cout << e.what() << endl;
+		num = num * 10 + (tok.data[i] - '0');
 	}
 	return num;
 }
 
 string JackTokenizer::stringVal()
 {
-	if (m_currentToken.size() > 2 && m_currentToken[0] == '"')
-		return m_currentToken.substr(1, m_currentToken.size()-2);
+	SourceView tok = view(current());
+
+	if (tok.size > 2 && tok.data[0] == '"')
+		return string(tok.data + 1, tok.size - 2);
 	else throw TokenMismatch( "string" );
 }
 
+SourceView JackTokenizer::tokenView()
+{
+	return view(current());
+}
+
@@ -7,39 +7,91 @@
 #include <map>
 
 #include "type_utils.h"
+#include "string_interner.h"
 
 using std::string;
-using std::istringstream;
 using std::vector;
 using std::map;
 using std::pair;
 
+/**
+Non-owning view over a range of characters
+(a source buffer or a token inside it).
+The viewed memory must outlive the view
+*/
+struct SourceView {
+public:
+	const char *data;
+	size_t size;
+
+	SourceView():data(0), size(0) {}
+	SourceView(const char *d, size_t s):data(d), size(s) {}
+	SourceView(const string &str):data(str.data()), size(str.size()) {}
+
+	const char* begin() const { return data; }
+	const char* end() const { return data + size; }
+	string str() const { return string(data, size); }
+
+	bool operator==(const string &str) const
+	{
+		return size == str.size() && str.compare(0, size, data, size) == 0;
+	}
+	bool operator!=(const string &str) const { return !(*this == str); }
+};
+
+/**
+One lexed token : its type (and keyword, classified
+once at lex time) and where it lies in the source text
+*/
+struct Token {
+public:
+	TYPE_TOKEN type;
+	TYPE_KEYWORD keyword;
+	unsigned int offset;
+	unsigned int length;
+	int line, column;
+	// interned at lex time, identifiers only
+	Atom atom;
+
+	Token():type(TOK_EMPTY), keyword(KW_UNKNOWN), offset(0), length(0), line(1), column(1), atom(NO_ATOM) {}
+	Token(TYPE_TOKEN t, TYPE_KEYWORD kw, unsigned int o, unsigned int l, int ln, int col)
+		:type(t), keyword(kw), offset(o), length(l), line(ln), column(col), atom(NO_ATOM) {}
+};
+
 class JackTokenizer {
 public:
 	/**
-	Opens the input file and gets ready
-	to parse it
+	Lexes the whole source text once into
+	a token array.
+	The text is NOT copied : it must outlive
+	the tokenizer (e.g. a memory-mapped file)
 	*/
-	JackTokenizer(string jackcode);
+	JackTokenizer(SourceView jackcode);
 	/**
 	Are there more tokens in the input ?
 	*/
 	bool hasMoreTokens();
 	/**
-	Reads the next token from the input
-	and makes it the current token.
+	Makes the next token the current token.
 	Should be called only if hasMoreTokens()
 	is true.
-	Initially there is no current token
+	Initially there is no current token.
+	Throws LexicalError when it reaches the place
+	where the source text couldn't be lexed
 	*/
 	void advance();
 	/**
-	Reads the next token from the input
+	Returns the k-th token after the current one
 	WITHOUT making it the current token.
-	Should be called only if hasMoreTokens()
-	is true.
+	Past the end, an empty token is returned
+	*/
+	pair<TYPE_TOKEN, string> peek(int k = 1);
+	/**
+	Goes back before the first token, so the same
+	token stream can be replayed by another pass
+	without lexing the source again
 	*/
-	pair<TYPE_TOKEN, string> peek();
+	void rewind();
 	/**
 	Returns the type of the current
 	token
@@ -58,6 +110,16 @@ public:
 	*/
 	string identifier();
 	/**
+	Same as identifier() but returns its atom
+	(no copy, no allocation)
+	*/
+	Atom identifierAtom();
+	/**
+	The interner of every identifier of the source;
+	other strings (types, names...) can be added to it
+	*/
+	StringInterner& interner();
+	/**
 	Only call this when token type == INT_CONST
 	*/
 	int intVal();
@@ -65,6 +127,11 @@ public:
 	Only call this when token type == STRING_CONST
 	*/
 	string stringVal();
+	/**
+	Returns the current token as a view into
+	the source text (no copy)
+	*/
+	SourceView tokenView();
 
 	/* helper functions */
 	/**
@@ -77,15 +144,34 @@ public:
 	int getCurrentColumn();
 
 private:
-	istringstream m_jackStreamCode;
-	string m_currentToken;
+	// source text and reading position (used while lexing)
+	const char *m_begin, *m_cur, *m_end;
+
+	// every token of the source, the last one is always empty
+	vector<Token> m_tokens;
+	// index of the current token (-1 before the first advance())
+	int m_index;
+	// identifiers are interned as they are lexed
+	StringInterner m_interner;
 
-	// keywords (defined in the constructor)
-	map<TYPE_KEYWORD, string> m_keywords;
-	vector<char> m_symbols;
+	// the lexing stopped on an error : the token array ends there
+	bool m_hasError;
+	string m_errorMessage;
+	int m_errorLine, m_errorColumn;
 
 	// storing current pointer position
 	int m_curLine, m_curCol;
+
+	// reads the next token from the source text
+	Token scan();
+	// stops the lexing, the error is reported by advance()
+	Token error(const string &message, int line, int column);
+	// moves the reading position to p, updating line/column
+	void skipTo(const char *p);
+	// builds a keyword, identifier or integer token
+	Token makeToken(const char *begin, size_t length, int line, int column);
+	const Token& current();
+	SourceView view(const Token &tok);
 };
 
 class TokenMismatch : public std::exception {
@@ -107,4 +193,35 @@ private:
 	string msg;
 };
 
+/**
+The source text can't be lexed (e.g. a string constant
+spanning several lines); the engines report it with the
+name of the file
+*/
+class LexicalError : public std::exception {
+public:
+	LexicalError( string message, int line, int column )
+		:m_message(message), m_line(line), m_column(column)
+	{
+		std::ostringstream oss;
+		oss << "Ln " << line << ", Col " << column << " : " << message;
+		this->msg = oss.str();
+	}
+
+	virtual ~LexicalError() throw() {}
+
+	virtual const char* what() const throw()
+	{
+		return this->msg.c_str();
+	}
+
+	const string& message() const { return m_message; }
+	int line() const { return m_line; }
+	int column() const { return m_column; }
+private:
+	string m_message;
+	int m_line, m_column;
+	string msg;
+};
+
 #endif
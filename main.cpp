@@ -4,42 +4,485 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <set>
+#include <sstream>
+#include <cstdlib>
 #include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/ref.hpp>
+#include <boost/scoped_ptr.hpp>
+#include "source_file.h"
+#include "thread_pool.h"
+#include "program_index.h"
+#include "build_cache.h"
+#include "directory_watcher.h"
+#include "compile_server.h"
 #include "jack_analyzer.h"
 #include "jack_compiler.h"
+#include "jack_library.h"
 
 using namespace std;
 using namespace boost::filesystem;
 
-/* this function use a path class, read the content
+typedef boost::shared_ptr<SourceFile> source_ptr;
+typedef boost::shared_ptr<ostringstream> diag_ptr;
+typedef boost::shared_ptr<BuildCache> cache_ptr;
+typedef boost::shared_ptr<ScannedFile> scanned_ptr;
+// compiles one file, errors are written in the given stream
+typedef boost::function<void (ostream&)> compile_task;
+
+/* this function use a path class, read (or map) the content
 and map the data to his path
 */
-pair<path, string> assoc_file_to_content(path p)
+pair<path, source_ptr> assoc_file_to_content(path p, bool use_mmap)
 {
-	ifstream in(p.string());
+	return pair<path, source_ptr>(p, source_ptr(new SourceFile(p, use_mmap)));
+}
 
-	// read data as a block
-	stringbuf sbuf;
-	in >> &sbuf;
+/* lex and scan one file once, its class goes to the index
+and its tokens are kept for the final pass
+*/
+void scan_file(SourceView pData, ProgramIndex *index, scanned_ptr *scanned)
+{
+	scanned->reset( new ScannedFile(pData) );
+	index->addFile(**scanned);
+}
 
-	// create a string from buffer data
-	string buf( sbuf.str() );
+/* compile (or analyze) one file, errors are written in diag;
+files compiled without error are recorded in the cache.
+A file not scanned yet (scanned is null) is lexed here
+*/
+void compile_file(path p, SourceView pData, ScannedFile *scanned, const ProgramIndex *index, BuildCache *cache,
+	const CodegenOptions &options, ostream &diag)
+{
+#ifdef XML_OUTPUT
+	JackAnalyzer janalyse(p, pData, diag);
+#else
+	boost::scoped_ptr<JackCompiler> compiler;
+	if (scanned)
+	{
+		compiler.reset( new JackCompiler(p, *scanned, index, diag, 0, options) );
+	}
+	else
+	{
+		compiler.reset( new JackCompiler(p, pData, index, diag, 0, options) );
+	}
 
-	return pair<path, string>(p, buf);
+	JackCompiler &jcompiler = *compiler;
+
+	if (cache && jcompiler.succeeded())
+	{
+		cache->store(p, pData, jcompiler.getClassName(), jcompiler.getMethodList(), jcompiler.getDependencies());
+	}
+#endif
 }
 
-int main(int argc, char **argv)
+/* run the tasks on the pool if there's one, the errors of
+each file are then buffered and flushed in the same order
+as a serial run
+*/
+void run_tasks(const vector<compile_task> &tasks, ThreadPool *pool, ostream &err)
+{
+	if (!pool)
+	{
+		for (vector<compile_task>::const_iterator it = tasks.begin(), it_end = tasks.end(); it != it_end; ++it)
+		{
+			(*it)(err);
+		}
+		return;
+	}
+
+	vector<diag_ptr> diagnostics;
+
+	for (vector<compile_task>::const_iterator it = tasks.begin(), it_end = tasks.end(); it != it_end; ++it)
+	{
+		diag_ptr diag(new ostringstream());
+		diagnostics.push_back(diag);
+
+		pool->submit( boost::bind(*it, boost::ref(*diag)) );
+	}
+
+	pool->wait();
+
+	for (vector<diag_ptr>::iterator it = diagnostics.begin(), it_end = diagnostics.end();
+		it != it_end; ++it)
+	{
+		err << (*it)->str();
+	}
+}
+
+/* what watch mode keeps in memory for each file
+between two compilations
+*/
+/* a cache the server keeps between requests, one per
+directory and options
+*/
+struct WarmCache {
+	path directory;
+	cache_ptr cache;
+	// the request that last used it
+	unsigned long lastUse;
+};
+
+// beyond it, the least recently used cache is dropped
+static const size_t MAX_WARM_CACHES = 8;
+
+struct warm_caches {
+	map<string, WarmCache> entries;
+	unsigned long requests;
+
+	warm_caches() :requests(0) {}
+};
+
+/* the warm cache of the directory, made if there's none ; the
+caches of the directories that are gone are dropped first
+*/
+cache_ptr get_warm_cache(warm_caches &caches, path directory, bool use_cache, const CodegenOptions &codegen_options)
+{
+	string key = directory.string() + (use_cache ? " -c " : " ") + codegen_options.key();
+	caches.requests++;
+
+	for (map<string, WarmCache>::iterator it = caches.entries.begin(); it != caches.entries.end(); )
+	{
+		boost::system::error_code ec;
+
+		if (it->first != key && !is_directory(it->second.directory, ec))
+			caches.entries.erase(it++);
+		else
+			++it;
+	}
+
+	map<string, WarmCache>::iterator found = caches.entries.find(key);
+
+	if (found == caches.entries.end())
+	{
+		if (caches.entries.size() >= MAX_WARM_CACHES)
+		{
+			map<string, WarmCache>::iterator oldest = caches.entries.begin();
+			for (map<string, WarmCache>::iterator it = caches.entries.begin(), it_end = caches.entries.end(); it != it_end; ++it)
+			{
+				if (it->second.lastUse < oldest->second.lastUse)
+					oldest = it;
+			}
+
+			caches.entries.erase(oldest);
+		}
+
+		WarmCache warm;
+		warm.directory = directory;
+		warm.cache.reset( new BuildCache(directory, codegen_options, use_cache) );
+
+		found = caches.entries.insert( make_pair(key, warm) ).first;
+	}
+
+	found->second.lastUse = caches.requests;
+	return found->second.cache;
+}
+
+struct WatchedFile {
+	source_ptr source;
+	// its tokens and signatures, from the last time it changed
+	scanned_ptr scanned;
+	string className;
+	// map< Class.subroutine, signature > the file relied on
+	map<string, SubroutineInfo> dependencies;
+};
+
+void compile_watched(path p, WatchedFile *file, const ProgramIndex *index, const CodegenOptions &options, ostream &diag)
+{
+#ifdef XML_OUTPUT
+	JackAnalyzer janalyse(p, file->source->view(), diag);
+#else
+	JackCompiler jcompiler(p, *file->scanned, index, diag, 0, options);
+	file->dependencies = jcompiler.getDependencies();
+#endif
+}
+
+bool same_signatures(const map<string, SubroutineInfo> &a, const map<string, SubroutineInfo> &b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (map<string, SubroutineInfo>::const_iterator it_a = a.begin(), it_b = b.begin(); it_a != a.end(); ++it_a, ++it_b)
+	{
+		if (it_a->first != it_b->first || it_a->second.kind != it_b->second.kind
+			|| it_a->second.type != it_b->second.type || it_a->second.nArgs != it_b->second.nArgs)
+			return false;
+	}
+
+	return true;
+}
+
+/* watch mode : the sources, the signature index and the
+dependencies of every file stay in memory. When files change,
+only them and the files calling a class whose signatures
+changed are compiled again
+*/
+void watch(path input, const map<path, source_ptr> &input_files, bool use_mmap,
+	const CodegenOptions &options, ThreadPool *pool)
+{
+	bool single_file = !is_directory(input);
+	path directory = single_file ? input.parent_path() : input;
+	if (directory.empty())
+	{
+		directory = ".";
+	}
+
+	DirectoryWatcher watcher(directory);
+	if (!watcher.isWatching())
+	{
+		cout << directory << " can't be watched (watch mode needs inotify)" << endl;
+		return;
+	}
+
+	ProgramIndex index;
+	map<path, WatchedFile> files;
+
+	// the first build compiles every file, their content was already read
+	bool first_build = true;
+	set<path> changes;
+	for (map<path, source_ptr>::const_iterator it = input_files.begin(), it_end = input_files.end(); it != it_end; ++it)
+	{
+		files[it->first].source = it->second;
+		changes.insert(it->first);
+	}
+
+	for (;; first_build = false)
+	{
+		set<path> to_compile;
+		set<string> changed_classes;
+
+		for (set<path>::iterator it = changes.begin(), it_end = changes.end(); it != it_end; ++it)
+		{
+			path p = *it;
+
+			if (p.extension() != ".jack" || (single_file && p.filename() != input.filename()))
+				continue;
+
+			// the previous signatures of the file
+			string old_name;
+			map<string, SubroutineInfo> old_methods;
+
+			map<path, WatchedFile>::iterator file = files.find(p);
+			if (file != files.end() && !file->second.className.empty())
+			{
+				old_name = file->second.className;
+				index.getClass(old_name, old_methods);
+				index.removeClass(old_name);
+			}
+
+			bool removed = !exists(p);
+			try
+			{
+				if (!removed && !first_build)
+				{
+					files[p].source = source_ptr(new SourceFile(p, use_mmap));
+				}
+			}
+			catch (const filesystem_error&)
+			{
+				removed = true;
+			}
+
+			if (removed)
+			{
+				files.erase(p);
+				changed_classes.insert(old_name);
+
+				// its generated file goes with it
+				path output = p;
+#ifdef XML_OUTPUT
+				output.replace_extension( ".xml" );
+#else
+				output.replace_extension( options.extension() );
+#endif
+
+				boost::system::error_code ec;
+				remove(output, ec);
+
+				// another file may declare the same class (a file renamed)
+				for (map<path, WatchedFile>::iterator other = files.begin(), other_end = files.end(); other != other_end; ++other)
+				{
+					if (!old_name.empty() && other->second.className == old_name)
+					{
+						index.addFile(*other->second.scanned);
+						break;
+					}
+				}
+
+				continue;
+			}
+
+			WatchedFile &watched = files[p];
+			watched.scanned.reset( new ScannedFile(watched.source->view()) );
+			watched.className = index.addFile(*watched.scanned);
+
+			map<string, SubroutineInfo> new_methods;
+			index.getClass(watched.className, new_methods);
+
+			if (watched.className != old_name || !same_signatures(old_methods, new_methods))
+			{
+				changed_classes.insert(old_name);
+				changed_classes.insert(watched.className);
+			}
+
+			to_compile.insert(p);
+		}
+
+		// the files calling a class whose signatures changed
+		for (map<path, WatchedFile>::iterator it = files.begin(), it_end = files.end(); it != it_end; ++it)
+		{
+			const map<string, SubroutineInfo> &deps = it->second.dependencies;
+
+			for (map<string, SubroutineInfo>::const_iterator dep = deps.begin(), dep_end = deps.end(); dep != dep_end; ++dep)
+			{
+				if (changed_classes.count( dep->first.substr(0, dep->first.find('.')) ))
+				{
+					to_compile.insert(it->first);
+					break;
+				}
+			}
+		}
+
+		vector<compile_task> tasks;
+		for (set<path>::iterator it = to_compile.begin(), it_end = to_compile.end(); it != it_end; ++it)
+		{
+			tasks.push_back( boost::bind(&compile_watched, *it, &files[*it], &index, options, _1) );
+		}
+
+		run_tasks(tasks, pool, cerr);
+
+		if (!tasks.empty())
+		{
+			cout << tasks.size() << " file(s) compiled" << endl;
+		}
+
+		changes = watcher.waitForChanges();
+		if (changes.empty())
+			return;
+	}
+}
+
+int usage(string prog, ostream &out)
+{
+	out << "usage: " << prog << " [-m] [-j N] [-c] [-b] [-O | --peephole=LIST] [--pool-strings] [--watch] (filename | directory)" << endl;
+	out << "       " << prog << " --serve SOCKET [-j N]" << endl;
+	out << "       " << prog << " --connect SOCKET [options] (filename | directory)" << endl;
+	out << "  -m               : memory-map the source files instead of reading them" << endl;
+	out << "  -j N             : compile N files in parallel" << endl;
+	out << "  -c               : keep a build cache (.jackcache), unchanged files are not compiled again" << endl;
+	out << "  -b               : write binary VM code (.vmb) instead of text (.vm)" << endl;
+	out << "  -O               : optimize the VM code (every peephole pattern, strength reduction)" << endl;
+	out << "  --peephole=LIST  : only the listed peephole patterns (push-pop, double-unary," << endl;
+	out << "                     constant-branch, temp-reload, jump-to-next, dead-code)" << endl;
+	out << "  --pool-strings   : build each string literal once, on its first use (literals must not be modified)" << endl;
+	out << "  --watch          : stay alive and compile the files again whenever they change (Linux only)" << endl;
+	out << "  --serve SOCKET   : compile server listening on a Unix socket (Unix only)" << endl;
+	out << "  --connect SOCKET : let the server listening on SOCKET do the compilation" << endl;
+	return 1;
+}
+
+/* reads an option changing the generated code : false if 'arg'
+isn't one, 'valid' is false if it is one but malformed
+*/
+bool parse_codegen_option(const string &arg, CodegenOptions &options, bool &valid)
 {
-	// verify that there's only 1 argument
-	if (argc != 2)
+	valid = true;
+
+	if (arg == "-b")
+	{
+		options.format = VM_BINARY;
+	}
+	else if (arg == "-O")
+	{
+		options.peephole = PEEP_ALL;
+		options.reduceStrength = true;
+	}
+	else if (arg.compare(0, 11, "--peephole=") == 0)
+	{
+		valid = parse_peephole_patterns(arg.substr(11), options.peephole);
+	}
+	else if (arg == "--pool-strings")
+	{
+		options.poolStrings = true;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+/* one run of the compiler on the command line arguments (without
+the program name). The server runs it for every request with its
+own thread pool, which is then used whatever '-j' says, and its
+caches : the one of the directory is kept in memory even without '-c'
+*/
+int run_compiler(string prog, const vector<string> &args, ostream &out, ostream &err,
+	ThreadPool *shared_pool, warm_caches *caches)
+{
+	bool use_mmap = false;
+	bool use_cache = false;
+	bool watch_mode = false;
+	int nJobs = 1;
+	string input;
+	// options which change the generated code, part of the cache key
+	CodegenOptions codegen_options;
+
+	// read options, then the only non-option argument
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		string arg = args[i];
+		bool valid;
+
+		if (arg == "-m")
+		{
+			use_mmap = true;
+		}
+		else if (arg == "-c")
+		{
+			use_cache = true;
+		}
+		else if (parse_codegen_option(arg, codegen_options, valid))
+		{
+			if (!valid)
+			{
+				return usage(prog, out);
+			}
+		}
+		else if (arg == "--watch")
+		{
+			watch_mode = true;
+		}
+		else if (arg == "-j" && i + 1 < args.size())
+		{
+			nJobs = atoi(args[++i].c_str());
+			if (nJobs < 1)
+			{
+				return usage(prog, out);
+			}
+		}
+		else if (input.empty() && arg.size() > 0 && arg[0] != '-')
+		{
+			input = arg;
+		}
+		else
+		{
+			return usage(prog, out);
+		}
+	}
+
+	if (input.empty())
 	{
-		cout << "usage: " << argv[0] << " (filename | directory)" << endl;
-		exit(1);
+		return usage(prog, out);
 	}
 
 	string in_ext_type = ".jack";
-	path p (argv[1]);
-	map<path, string> input_files;
+	path p (input);
+	map<path, source_ptr> input_files;
 
 	/*
 	first, we test the existence of the pathname. then,
@@ -53,7 +496,7 @@ int main(int argc, char **argv)
 		{
 			if (is_regular_file(p) && p.extension() == in_ext_type)
 			{			
-				input_files.insert( assoc_file_to_content(p) );
+				input_files.insert( assoc_file_to_content(p, use_mmap) );
 			}
 			else if (is_directory(p))
 			{
@@ -69,38 +512,235 @@ int main(int argc, char **argv)
 
 					if (p.extension() == in_ext_type)
 					{
-						input_files.insert( assoc_file_to_content(p) );
+						input_files.insert( assoc_file_to_content(p, use_mmap) );
 					}
 					
 				}
 			}
 			else
 			{
-				cout << p << " exists, but is neither a regular file nor a directory " << endl;
+				out << p << " exists, but is neither a regular file nor a directory " << endl;
 			}
 		}
 		else
 		{
-			cout << p << " does not exist" << endl;
+			out << p << " does not exist" << endl;
 		}
 	}
 	catch(const filesystem_error& e)
 	{
-		cout << e.what() << endl;
+		out << e.what() << endl;
+	}
+
+	boost::scoped_ptr<ThreadPool> own_pool;
+	ThreadPool *pool = shared_pool;
+
+	if (!pool && nJobs > 1)
+	{
+		own_pool.reset( new ThreadPool(nJobs) );
+		pool = own_pool.get();
+	}
+
+	if (watch_mode)
+	{
+		watch(p, input_files, use_mmap, codegen_options, pool);
+		return 0;
 	}
 
-	for (map<path, string>::iterator it = input_files.begin(), it_end = input_files.end();
+	ProgramIndex index;
+	cache_ptr cache;
+	// the files scanned for the index, map< path, scan >
+	map<path, scanned_ptr> scanned_files;
+
+#ifndef XML_OUTPUT
+	// files whose content didn't change give their signatures from the cache
+	map<path, source_ptr> cached_files;
+
+	if ((use_cache || caches) && !input_files.empty())
+	{
+		path directory = input_files.begin()->first.parent_path();
+
+		if (caches)
+		{
+			cache = get_warm_cache(*caches, absolute(directory), use_cache, codegen_options);
+		}
+		else
+		{
+			cache.reset( new BuildCache(directory, codegen_options) );
+		}
+
+		for (map<path, source_ptr>::iterator it = input_files.begin(); it != input_files.end(); )
+		{
+			if (cache->lookup(it->first, it->second->view(), index))
+			{
+				cached_files.insert(*it);
+				input_files.erase(it++);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	/* the signatures of every class are indexed before
+	any file is compiled, so that calls to other classes
+	can be checked without parsing them again; the tokens
+	are kept, each file is lexed once
+	*/
+	for (map<path, source_ptr>::iterator it = input_files.begin(), it_end = input_files.end();
 		it != it_end; ++it)
 	{
-		path p = it->first;
-		string pData = it->second;
+		scanned_files[it->first];
+	}
 
-#ifdef XML_OUTPUT
-		JackAnalyzer janalyse(p, pData);
-#else
-		JackCompiler jcompiler(p, pData);
+	for (map<path, source_ptr>::iterator it = input_files.begin(), it_end = input_files.end();
+		it != it_end; ++it)
+	{
+		scanned_ptr *scan = &scanned_files[it->first];
+
+		if (pool)
+		{
+			pool->submit( boost::bind(&scan_file, it->second->view(), &index, scan) );
+		}
+		else
+		{
+			scan_file(it->second->view(), &index, scan);
+		}
+	}
+
+	if (pool)
+	{
+		pool->wait();
+	}
+
+	// an unchanged file is compiled again only if a signature it called has changed
+	for (map<path, source_ptr>::iterator it = cached_files.begin(), it_end = cached_files.end();
+		it != it_end; ++it)
+	{
+		if (!cache->restore(it->first, index))
+		{
+			input_files.insert(*it);
+		}
+	}
 #endif
+
+	vector<compile_task> tasks;
+	for (map<path, source_ptr>::iterator it = input_files.begin(), it_end = input_files.end();
+		it != it_end; ++it)
+	{
+		ScannedFile *scanned = scanned_files[it->first].get();
+		tasks.push_back( boost::bind(&compile_file, it->first, it->second->view(), scanned, &index, cache.get(), codegen_options, _1) );
+	}
+
+	run_tasks(tasks, pool, err);
+
+	if (cache)
+	{
+		cache->save();
+	}
+
+	return 0;
+}
+
+/* a request sent to the server, watch mode can't be used
+*/
+int serve_request(string prog, ThreadPool *pool, warm_caches *caches,
+	const vector<string> &args, ostream &out, ostream &err)
+{
+	if (find(args.begin(), args.end(), "--watch") != args.end())
+	{
+		err << "--watch can't be used through the server" << endl;
+		return 1;
+	}
+
+	return run_compiler(prog, args, out, err, pool, caches);
+}
+
+/* in-memory units sent to the server, only the options
+changing the generated code apply to them
+*/
+int serve_units(ThreadPool *pool, const vector<string> &options, const vector<SourceUnit> &units,
+	vector<CompileResult> &results, ostream &err)
+{
+	CodegenOptions codegen_options;
+
+	for (vector<string>::const_iterator it = options.begin(), it_end = options.end(); it != it_end; ++it)
+	{
+		bool valid;
+		if (!parse_codegen_option(*it, codegen_options, valid) || !valid)
+		{
+			err << "invalid option for in-memory units : " << *it << endl;
+			return 1;
+		}
+	}
+
+	results = compile_program(units, pool, codegen_options);
+
+	for (vector<CompileResult>::const_iterator it = results.begin(), it_end = results.end(); it != it_end; ++it)
+	{
+		if (!it->succeeded)
+			return 1;
 	}
 
 	return 0;
+}
+
+/* server mode : the process, its thread pool and the caches
+stay alive, every request is one run of the compiler
+*/
+int serve(string prog, string socketPath, const vector<string> &args)
+{
+	int nJobs = boost::thread::hardware_concurrency();
+
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		if (args[i] == "-j" && i + 1 < args.size())
+		{
+			nJobs = atoi(args[++i].c_str());
+		}
+		else
+		{
+			return usage(prog, cout);
+		}
+	}
+
+	ThreadPool pool( max(nJobs, 1) );
+	warm_caches caches;
+	CompileServer server(socketPath, boost::bind(&serve_request, prog, &pool, &caches, _1, _2, _3),
+		boost::bind(&serve_units, &pool, _1, _2, _3, _4));
+
+	if (!server.isListening())
+	{
+		cout << "can't listen on " << socketPath << " (the server needs Unix sockets)" << endl;
+		return 1;
+	}
+
+	server.run();
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	string prog = argv[0];
+	vector<string> args(argv + 1, argv + argc);
+
+	// server and client modes come first on the command line
+	if (args.size() >= 2 && args[0] == "--serve")
+	{
+		return serve(prog, args[1], vector<string>(args.begin() + 2, args.end()));
+	}
+
+	if (args.size() >= 2 && args[0] == "--connect")
+	{
+		int status = forward_to_server(args[1], vector<string>(args.begin() + 2, args.end()));
+		if (status < 0)
+		{
+			cout << "can't reach the server on " << args[1] << endl;
+			return 1;
+		}
+		return status;
+	}
+
+	return run_compiler(prog, args, cout, cerr, 0, 0);
 }
\ No newline at end of file
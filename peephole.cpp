@@ -0,0 +1,176 @@
+#include "peephole.h"
+
+using namespace std;
+
+static bool is_push(const VMInstruction &inst, SEGMENT seg, int index)
+{
+	return inst.opcode == OP_PUSH && inst.segment() == seg && inst.index == index;
+}
+
+static bool is_pop(const VMInstruction &inst, SEGMENT seg, int index)
+{
+	return inst.opcode == OP_POP && inst.segment() == seg && inst.index == index;
+}
+
+static bool is_command(const VMInstruction &inst, COMMAND cmd)
+{
+	return inst.opcode == OP_ARITHMETIC && inst.command() == cmd;
+}
+
+PeepholeOptimizer::PeepholeOptimizer(unsigned int patterns)
+	:m_patterns(patterns)
+{
+}
+
+void PeepholeOptimizer::run(VMCode &code) const
+{
+	VMCode optimized;
+	optimized.reserve( code.size() );
+
+	for (VMCode::const_iterator it = code.begin(), it_end = code.end(); it != it_end; ++it)
+	{
+		if (enabled(PEEP_DEAD_CODE) && !optimized.empty()
+			&& it->opcode != OP_LABEL && it->opcode != OP_FUNCTION)
+		{
+			unsigned char last = optimized.back().opcode;
+
+			if (last == OP_GOTO || last == OP_RETURN)
+				continue;
+		}
+
+		optimized.push_back( *it );
+
+		while (rewriteTail( optimized ))
+			;
+	}
+
+	code.swap( optimized );
+}
+
+bool PeepholeOptimizer::rewriteTail(VMCode &code) const
+{
+	size_t n = code.size();
+	if (n < 2)
+		return false;
+
+	VMInstruction &last = code[n - 1];
+	VMInstruction &prev = code[n - 2];
+
+	if (enabled(PEEP_PUSH_POP) && prev.opcode == OP_PUSH && last.opcode == OP_POP
+		&& prev.arg == last.arg && prev.index == last.index && prev.segment() != SEG_CONST)
+	{
+		code.resize( n - 2 );
+		return true;
+	}
+
+	if (enabled(PEEP_DOUBLE_UNARY) && prev.opcode == OP_ARITHMETIC && last.opcode == OP_ARITHMETIC
+		&& prev.arg == last.arg && (prev.command() == C_NOT || prev.command() == C_NEG))
+	{
+		code.resize( n - 2 );
+		return true;
+	}
+
+	if (enabled(PEEP_CONSTANT_BRANCH) && last.opcode == OP_IF)
+	{
+		// the constant is 0..32767 : ~c is never 0, -c only when c is
+		bool jumps = false;
+		size_t length = 0;
+
+		if (prev.opcode == OP_PUSH && prev.segment() == SEG_CONST)
+		{
+			jumps = prev.index != 0;
+			length = 2;
+		}
+		else if (n >= 3 && code[n - 3].opcode == OP_PUSH && code[n - 3].segment() == SEG_CONST)
+		{
+			if (is_command(prev, C_NOT))
+			{
+				jumps = true;
+				length = 3;
+			}
+			else if (is_command(prev, C_NEG))
+			{
+				jumps = code[n - 3].index != 0;
+				length = 3;
+			}
+		}
+
+		if (length > 0)
+		{
+			VMInstruction jump = last;
+			jump.opcode = OP_GOTO;
+
+			code.resize( n - length );
+			if (jumps)
+				code.push_back( jump );
+
+			return true;
+		}
+	}
+
+	if (enabled(PEEP_TEMP_RELOAD))
+	{
+		if (is_pop(prev, SEG_TEMP, 0) && is_push(last, SEG_TEMP, 0))
+		{
+			code.resize( n - 2 );
+			return true;
+		}
+
+		// 'let a[i] = X' : X is pushed once 'that' points to a[i]
+		if (n >= 5 && code[n - 5].opcode == OP_PUSH && is_pop(code[n - 4], SEG_TEMP, 0)
+			&& is_pop(code[n - 3], SEG_POINTER, 1) && is_push(prev, SEG_TEMP, 0) && is_pop(last, SEG_THAT, 0))
+		{
+			SEGMENT seg = code[n - 5].segment();
+
+			if (seg != SEG_THAT && seg != SEG_POINTER && seg != SEG_TEMP)
+			{
+				VMInstruction value = code[n - 5];
+				VMInstruction pointer = code[n - 3];
+				VMInstruction store = last;
+
+				code.resize( n - 5 );
+				code.push_back( pointer );
+				code.push_back( value );
+				code.push_back( store );
+				return true;
+			}
+		}
+	}
+
+	if (enabled(PEEP_JUMP_TO_NEXT) && prev.opcode == OP_GOTO && last.opcode == OP_LABEL
+		&& prev.name == last.name && prev.index == last.index)
+	{
+		code.erase( code.end() - 2 );
+		return true;
+	}
+
+	return false;
+}
+
+bool parse_peephole_patterns(const string &list, unsigned int &patterns)
+{
+	patterns = 0;
+
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t end = list.find( ',', start );
+		if (end == string::npos)
+			end = list.size();
+
+		string name = list.substr( start, end - start );
+
+		if (name == "push-pop") patterns |= PEEP_PUSH_POP;
+		else if (name == "double-unary") patterns |= PEEP_DOUBLE_UNARY;
+		else if (name == "constant-branch") patterns |= PEEP_CONSTANT_BRANCH;
+		else if (name == "temp-reload") patterns |= PEEP_TEMP_RELOAD;
+		else if (name == "jump-to-next") patterns |= PEEP_JUMP_TO_NEXT;
+		else if (name == "dead-code") patterns |= PEEP_DEAD_CODE;
+		else if (name == "all") patterns |= PEEP_ALL;
+		else return false;
+
+		start = end + 1;
+	}
+
+	return true;
+}
@@ -0,0 +1,61 @@
+#ifndef _PEEPHOLE_H
+#define _PEEPHOLE_H
+
+#include <string>
+#include "vm_code.h"
+
+using std::string;
+
+/**
+Rewrite patterns of the peephole optimizer, one bit each
+*/
+enum PEEPHOLE_PATTERN {
+	// push S i; pop S i				-> (nothing)
+	PEEP_PUSH_POP = 1 << 0,
+	// not; not | neg; neg			-> (nothing)
+	PEEP_DOUBLE_UNARY = 1 << 1,
+	// push constant c; (not|neg)?; if-goto L	-> goto L, or nothing when it never jumps
+	PEEP_CONSTANT_BRANCH = 1 << 2,
+	// pop temp 0; push temp 0			-> (nothing)
+	// push X; pop temp 0; pop pointer 1; push temp 0; pop that 0
+	//								-> pop pointer 1; push X; pop that 0
+	PEEP_TEMP_RELOAD = 1 << 3,
+	// goto L; label L				-> label L
+	PEEP_JUMP_TO_NEXT = 1 << 4,
+	// what follows goto or return, up to the next label, is dropped
+	PEEP_DEAD_CODE = 1 << 5,
+
+	PEEP_ALL = (1 << 6) - 1
+};
+
+/**
+Windowed peephole optimizer over the code of one subroutine :
+instructions are copied one by one and the patterns are matched
+against the end of the copy, so that a rewrite can enable another
+one (e.g. 'push constant 0; not; not; if-goto L' vanishes).
+The 'pop temp 0' after a discarded call is kept : the VM has
+no other way to drop the returned value
+*/
+class PeepholeOptimizer {
+public:
+	// patterns : PEEPHOLE_PATTERN flags
+	PeepholeOptimizer(unsigned int patterns);
+
+	void run(VMCode &code) const;
+
+private:
+	unsigned int m_patterns;
+
+	// rewrites the end of code once, returns false if no pattern matched
+	bool rewriteTail(VMCode &code) const;
+	bool enabled(PEEPHOLE_PATTERN pattern) const { return (m_patterns & pattern) != 0; }
+};
+
+/**
+Reads a comma-separated list of pattern names (push-pop, double-unary,
+constant-branch, temp-reload, jump-to-next, dead-code or all);
+false if a name is unknown
+*/
+bool parse_peephole_patterns(const string &list, unsigned int &patterns);
+
+#endif
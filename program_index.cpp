@@ -0,0 +1,55 @@
+#include "program_index.h"
+
+using namespace std;
+
+string ProgramIndex::addFile(ScannedFile &scanned)
+{
+	string className = scanned.getClassName();
+
+	if ( !className.empty() )
+	{
+		addClass( className, scanned.getMethodList() );
+	}
+
+	return className;
+}
+
+void ProgramIndex::addClass(const string &className, const map<string, SubroutineInfo> &methods)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_classes[className] = methods;
+}
+
+void ProgramIndex::removeClass(const string &className)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_classes.erase(className);
+}
+
+bool ProgramIndex::getClass(const string &className, map<string, SubroutineInfo> &methods) const
+{
+	map<string, map<string, SubroutineInfo> >::const_iterator cls = m_classes.find(className);
+	if (cls == m_classes.end())
+		return false;
+
+	methods = cls->second;
+	return true;
+}
+
+bool ProgramIndex::hasClass(const string &className) const
+{
+	return m_classes.find(className) != m_classes.end();
+}
+
+const SubroutineInfo* ProgramIndex::find(const string &className, const string &subroutineName) const
+{
+	map<string, map<string, SubroutineInfo> >::const_iterator cls = m_classes.find(className);
+	if (cls == m_classes.end())
+		return 0;
+
+	map<string, SubroutineInfo>::const_iterator sub = cls->second.find(subroutineName);
+	if (sub == cls->second.end())
+		return 0;
+
+	return &sub->second;
+}
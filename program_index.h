@@ -0,0 +1,55 @@
+#ifndef _PROGRAM_INDEX_H
+#define _PROGRAM_INDEX_H
+
+#include <string>
+#include <map>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "type_utils.h"
+#include "declaration_scanner.h"
+
+using std::string;
+using std::map;
+
+/**
+Whole-program index of subroutine signatures :
+for every class of the program, its subroutines
+(kind, return type, number of arguments).
+Classes can be added concurrently (parallel scan); the
+lookups don't lock, they're only made once the index is
+complete (final pass, between two rounds of watch mode)
+*/
+class ProgramIndex : private boost::noncopyable {
+public:
+	/**
+	Add the class of a scanned source file (the tokens are
+	kept for the final pass), malformed classes are left
+	to the final pass.
+	Returns the class name (empty if it wasn't added)
+	*/
+	string addFile(ScannedFile &scanned);
+	void addClass(const string &className, const map<string, SubroutineInfo> &methods);
+	void removeClass(const string &className);
+	/**
+	Copies the signatures of the class, returns false
+	if it isn't part of the program
+	*/
+	bool getClass(const string &className, map<string, SubroutineInfo> &methods) const;
+	/**
+	Is the class part of the program ?
+	(OS classes such as Math are not)
+	*/
+	bool hasClass(const string &className) const;
+	/**
+	Returns the signature of className.subroutineName,
+	or 0 if there's none
+	*/
+	const SubroutineInfo* find(const string &className, const string &subroutineName) const;
+
+private:
+	// only taken by the changes
+	boost::mutex m_mutex;
+	map<string, map<string, SubroutineInfo> > m_classes;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include <fstream>
+#include <sstream>
+#include "source_file.h"
+
+using namespace std;
+
+SourceFile::SourceFile(path p, bool use_mmap)
+	:m_mapped(false)
+{
+	// an empty file can't be mapped
+	if (use_mmap && boost::filesystem::file_size(p) > 0)
+	{
+		try
+		{
+			m_mapping.open( p.string() );
+			m_mapped = m_mapping.is_open();
+		}
+		catch (const exception&)
+		{
+			// we fall back on a plain read
+			m_mapped = false;
+		}
+	}
+
+	if (!m_mapped)
+	{
+		std::ifstream in(p.string().c_str(), ios::in | ios::binary);
+
+		// read data as a block
+		stringbuf sbuf;
+		in >> &sbuf;
+
+		m_content = sbuf.str();
+	}
+}
+
+SourceView SourceFile::view() const
+{
+	if (m_mapped)
+		return SourceView(m_mapping.data(), m_mapping.size());
+
+	return SourceView(m_content);
+}
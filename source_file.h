@@ -0,0 +1,31 @@
+#ifndef _SOURCE_FILE_H
+#define _SOURCE_FILE_H
+
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "jack_tokenizer.h"
+
+using std::string;
+using boost::filesystem::path;
+
+/**
+Holds the content of one JACK source file.
+The content is either read in memory (one copy)
+or memory-mapped (no copy at all); in both cases
+the tokenizer only gets a view over it
+*/
+class SourceFile : private boost::noncopyable {
+public:
+	SourceFile(path p, bool use_mmap);
+
+	SourceView view() const;
+
+private:
+	boost::iostreams::mapped_file_source m_mapping;
+	string m_content;
+	bool m_mapped;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "string_interner.h"
+
+using namespace std;
+
+// initial number of slots, enough for most classes
+static const size_t INITIAL_SLOTS = 256;
+
+StringInterner::StringInterner()
+	:m_slots(INITIAL_SLOTS, NO_ATOM)
+{
+}
+
+boost::uint32_t StringInterner::hash(const char *str, size_t length)
+{
+	// 32-bit FNV-1a
+	boost::uint32_t h = 2166136261U;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		h = (h ^ static_cast<unsigned char>(str[i])) * 16777619U;
+	}
+
+	return h;
+}
+
+size_t StringInterner::slotOf(const char *str, size_t length, boost::uint32_t h) const
+{
+	size_t mask = m_slots.size() - 1;
+
+	for (size_t slot = h & mask; ; slot = (slot + 1) & mask)
+	{
+		Atom atom = m_slots[slot];
+
+		if (atom == NO_ATOM)
+			return slot;
+
+		if (m_hashes[atom] == h && m_strings[atom].size() == length
+			&& memcmp(m_strings[atom].data(), str, length) == 0)
+			return slot;
+	}
+}
+
+Atom StringInterner::find(const char *str, size_t length) const
+{
+	return m_slots[ slotOf(str, length, hash(str, length)) ];
+}
+
+Atom StringInterner::intern(const char *str, size_t length)
+{
+	boost::uint32_t h = hash(str, length);
+	size_t slot = slotOf(str, length, h);
+
+	if (m_slots[slot] != NO_ATOM)
+		return m_slots[slot];
+
+	Atom atom = static_cast<Atom>(m_strings.size());
+	m_strings.push_back( string(str, length) );
+	m_hashes.push_back( h );
+	m_slots[slot] = atom;
+
+	// keep the load factor under 1/2
+	if (m_strings.size() * 2 > m_slots.size())
+		grow();
+
+	return atom;
+}
+
+void StringInterner::grow()
+{
+	vector<Atom> slots(m_slots.size() * 2, NO_ATOM);
+	size_t mask = slots.size() - 1;
+
+	for (Atom atom = 0; atom < m_strings.size(); atom++)
+	{
+		size_t slot = m_hashes[atom] & mask;
+		while (slots[slot] != NO_ATOM)
+			slot = (slot + 1) & mask;
+
+		slots[slot] = atom;
+	}
+
+	m_slots.swap(slots);
+}
@@ -0,0 +1,50 @@
+#ifndef _STRING_INTERNER_H
+#define _STRING_INTERNER_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <boost/cstdint.hpp>
+
+using std::string;
+using std::vector;
+
+// an interned string : equal strings get the same atom
+typedef boost::uint32_t Atom;
+
+const Atom NO_ATOM = 0xFFFFFFFF;
+
+/**
+Hands out 32-bit atoms for strings (one interner per
+compilation) : once interned, identifiers are compared
+and looked up as integers.
+Atoms are dense (0, 1, 2...) so they can index arrays
+*/
+class StringInterner {
+public:
+	StringInterner();
+
+	Atom intern(const char *str, size_t length);
+	Atom intern(const string &str) { return intern(str.data(), str.size()); }
+	/**
+	Returns NO_ATOM if the string was never interned
+	*/
+	Atom find(const char *str, size_t length) const;
+	Atom find(const string &str) const { return find(str.data(), str.size()); }
+
+	const string& str(Atom atom) const { return m_strings[atom]; }
+	size_t size() const { return m_strings.size(); }
+
+private:
+	vector<string> m_strings;
+	vector<boost::uint32_t> m_hashes;
+	// open addressing (linear probing), the size is a power of 2
+	vector<Atom> m_slots;
+
+	static boost::uint32_t hash(const char *str, size_t length);
+	// the slot holding the string, or the empty slot where it would go
+	size_t slotOf(const char *str, size_t length, boost::uint32_t h) const;
+	void grow();
+};
+
+#endif
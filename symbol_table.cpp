@@ -1,50 +1,145 @@
-#include <stdexcept>
-#include <sstream>
-
 #include "symbol_table.h"
 
 using namespace std;
 
+// enough for the symbols of most classes and subroutines
+static const size_t INITIAL_SLOTS = 64;
+
+// depth of the class scope, the subroutine scope is right above
+static const unsigned int CLASS_DEPTH = 0;
+static const unsigned int SUBROUTINE_DEPTH = 1;
+
+SymbolTable::SymbolTable()
+	:m_slots(INITIAL_SLOTS),
+	m_used(0),
+	m_generations(SUBROUTINE_DEPTH + 1, 1),
+	m_depth(CLASS_DEPTH),
+	static_cur_index(0),
+	field_cur_index(0),
+	arg_cur_index(0),
+	var_cur_index(0)
+{
+}
+
+bool SymbolTable::isLive(const Slot &slot) const
+{
+	return slot.name != NO_ATOM && slot.depth <= m_depth
+		&& slot.generation == m_generations[slot.depth];
+}
+
+void SymbolTable::pushScope()
+{
+	m_depth++;
+
+	if (m_generations.size() <= m_depth)
+		m_generations.push_back(1);
+}
+
+void SymbolTable::popScope()
+{
+	if (m_depth == CLASS_DEPTH)
+		return;
+
+	// every slot of this scope dies at once
+	m_generations[m_depth]++;
+	m_depth--;
+}
+
 void SymbolTable::startSubroutine()
 {
 	arg_cur_index = 0;
 	var_cur_index = 0;
 
-	m_subroutine_scope.clear();
+	while (m_depth > CLASS_DEPTH)
+		popScope();
+
+	pushScope();
 }
 
-void SymbolTable::Define(string name, string type, KIND kind)
+void SymbolTable::insert(unsigned int depth, Atom name, Symbol symbol)
 {
-	switch ( kind )
+	size_t mask = m_slots.size() - 1;
+	size_t free_slot = m_slots.size();
+	size_t slot = name & mask;
+
+	// the whole probing sequence is read : dead slots may hide live ones
+	for (; m_slots[slot].name != NO_ATOM; slot = (slot + 1) & mask)
 	{
-	case K_STATIC:
+		const Slot &cur = m_slots[slot];
+
+		if (isLive(cur))
 		{
-			pair<string, SymbolInfo> static_id( name, SymbolInfo(type, kind, static_cur_index) );
-			m_class_scope.insert(static_id);
-			static_cur_index++;
-			break;
+			// the first definition of a name in a scope is kept
+			if (cur.name == name && cur.depth == depth)
+				return;
 		}
-	case K_FIELD:
+		else if (free_slot == m_slots.size())
 		{
-			pair<string, SymbolInfo> field_id( name, SymbolInfo(type, kind, field_cur_index) );
-			m_class_scope.insert(field_id);
-			field_cur_index++;
-			break;
+			free_slot = slot;
 		}
+	}
+
+	// a dead slot is reused before a never used one
+	if (free_slot == m_slots.size())
+	{
+		free_slot = slot;
+		m_used++;
+	}
+
+	Slot &target = m_slots[free_slot];
+	target.name = name;
+	target.depth = depth;
+	target.generation = m_generations[depth];
+	target.symbol = symbol;
+
+	// keep the load factor under 1/2
+	if (m_used * 2 > m_slots.size())
+		grow();
+}
+
+void SymbolTable::grow()
+{
+	vector<Slot> old_slots(m_slots.size() * 2);
+	old_slots.swap(m_slots);
+
+	size_t mask = m_slots.size() - 1;
+	m_used = 0;
+
+	// only the live slots are kept
+	for (vector<Slot>::iterator it = old_slots.begin(), it_end = old_slots.end(); it != it_end; ++it)
+	{
+		if (!isLive(*it))
+			continue;
+
+		size_t slot = it->name & mask;
+		while (m_slots[slot].name != NO_ATOM)
+			slot = (slot + 1) & mask;
+
+		m_slots[slot] = *it;
+		m_used++;
+	}
+}
+
+void SymbolTable::Define(Atom name, Atom type, KIND kind)
+{
+	switch ( kind )
+	{
+	case K_STATIC:
+		insert( CLASS_DEPTH, name, Symbol(kind, static_cur_index, type) );
+		static_cur_index++;
+		break;
+	case K_FIELD:
+		insert( CLASS_DEPTH, name, Symbol(kind, field_cur_index, type) );
+		field_cur_index++;
+		break;
 	case K_ARG:
-		{
-			pair<string, SymbolInfo> arg_id( name, SymbolInfo(type, kind, arg_cur_index) );
-			m_subroutine_scope.insert(arg_id);
-			arg_cur_index++;
-			break;
-		}
+		insert( m_depth, name, Symbol(kind, arg_cur_index, type) );
+		arg_cur_index++;
+		break;
 	case K_VAR:
-		{
-			pair<string, SymbolInfo> var_id( name, SymbolInfo(type, kind, var_cur_index) );
-			m_subroutine_scope.insert(var_id);
-			var_cur_index++;
-			break;
-		}
+		insert( m_depth, name, Symbol(kind, var_cur_index, type) );
+		var_cur_index++;
+		break;
 	}
 }
 
@@ -60,44 +155,18 @@ int SymbolTable::VarCount(KIND kind)
 	return val;
 }
 
-SymbolInfo SymbolTable::FindSymbolInfo(string name)
+Symbol SymbolTable::resolve(Atom name) const
 {
-	SymbolInfo si;
-
-	typedef map<string, SymbolInfo> map_symbol;
-	map_symbol::iterator symInfo_class = m_class_scope.find( name );
-	map_symbol::iterator symInfo_subroutine = m_subroutine_scope.find( name );
+	size_t mask = m_slots.size() - 1;
+	const Slot *found = 0;
 
-	if ( symInfo_class != m_class_scope.end() )
-	{
-		si = symInfo_class->second;
-	}
-	else if ( symInfo_subroutine != m_subroutine_scope.end() )
+	for (size_t slot = name & mask; m_slots[slot].name != NO_ATOM; slot = (slot + 1) & mask)
 	{
-		si = symInfo_subroutine->second;
-	}
-	else
-	{
-		// we must not invoke exceptions !
-		/*ostringstream oss;
-		oss << "Couldn't found the symbol info with the name \"" << name << "\"";
-		throw runtime_error( oss.str() );*/
-	}
-
-	return si;
-}
-
-KIND SymbolTable::KindOf(string name)
-{
-	return FindSymbolInfo( name ).kind;
-}
+		const Slot &cur = m_slots[slot];
 
-string SymbolTable::TypeOf(string name)
-{
-	return FindSymbolInfo( name ).type;
-}
+		if (cur.name == name && isLive(cur) && (!found || cur.depth > found->depth))
+			found = &cur;
+	}
 
-int SymbolTable::IndexOf(string name)
-{
-	return FindSymbolInfo( name ).index;
+	return found ? found->symbol : Symbol();
 }
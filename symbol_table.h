@@ -1,40 +1,88 @@
 #ifndef _SYMBOL_TABLE_H
 #define _SYMBOL_TABLE_H
 
-#include <string>
-#include <map>
+#include <vector>
 #include "type_utils.h"
+#include "string_interner.h"
 
 
-using std::string;
-using std::map;
+using std::vector;
 
+/**
+What a name resolves to : kind (K_NONE if the name
+isn't defined), index in its segment and type
+*/
+struct Symbol {
+public:
+	KIND kind;
+	int index;
+	Atom type;
+
+	Symbol():kind(K_NONE), index(0), type(NO_ATOM) {}
+	Symbol(KIND k, int i, Atom t):kind(k), index(i), type(t) {}
+
+	bool found() const { return kind != K_NONE; }
+};
+
+/**
+Scope stack of symbols in one flat open-addressing table keyed
+by atoms : the class scope at the bottom, then the subroutine
+scope, then any nested block scope.
+Each slot is stamped with its scope depth and the generation of
+that depth; leaving a scope bumps its generation, which kills all
+its slots at once. Dead slots are reused, so entering and leaving
+scopes costs nothing and allocates nothing
+*/
 class SymbolTable {
 public:
-	SymbolTable()
-		:static_cur_index(0),
-		field_cur_index(0),
-		arg_cur_index(0),
-		var_cur_index(0)
-	{}
+	SymbolTable();
 
+	/**
+	Leaves every scope but the class one and
+	opens the scope of a new subroutine
+	*/
 	void startSubroutine();
-	void Define(string name, string type, KIND kind);
+	/**
+	Nested scope inside the subroutine : its locals
+	shadow the outer names and keep their own indexes
+	*/
+	void pushScope();
+	void popScope();
+	void Define(Atom name, Atom type, KIND kind);
 	int VarCount(KIND kind);
-	KIND KindOf(string name);
-	string TypeOf(string name);
-	int IndexOf(string name);
+	/**
+	One lookup for everything known about a name,
+	the innermost definition wins
+	*/
+	Symbol resolve(Atom name) const;
 private:
-	// identifier name is used as a key
-	map<string, SymbolInfo> m_class_scope;
-	map<string, SymbolInfo> m_subroutine_scope;
+	struct Slot {
+		// NO_ATOM : the slot was never used
+		Atom name;
+		unsigned int depth;
+		unsigned int generation;
+		Symbol symbol;
+
+		Slot():name(NO_ATOM), depth(0), generation(0) {}
+	};
+
+	// the size is a power of 2
+	vector<Slot> m_slots;
+	// slots ever used (live or dead), to keep the probing short
+	size_t m_used;
+	// current generation of each scope depth
+	vector<unsigned int> m_generations;
+	unsigned int m_depth;
+
 	// for each kind, we store how many indexes are used
 	int static_cur_index;
 	int field_cur_index;
 	int arg_cur_index;
 	int var_cur_index;
 
-	SymbolInfo FindSymbolInfo(string name);
+	bool isLive(const Slot &slot) const;
+	void insert(unsigned int depth, Atom name, Symbol symbol);
+	void grow();
 };
 
 #endif
@@ -0,0 +1,41 @@
+#!/bin/sh
+# usage : optimized_test.sh JACKC
+# every program compiled with -O must give its <Class>_O.vm files,
+# and on 7Peephole every peephole pattern must change the code
+JACKC=$1
+DIR=$(cd "$(dirname "$0")" && pwd)
+WORK=/tmp/jack_optimized_test.$$
+PATTERNS="push-pop double-unary constant-branch temp-reload jump-to-next dead-code"
+
+trap 'rm -rf "$WORK"' EXIT
+status=0
+
+for program in "$DIR"/*/; do
+	name=$(basename "$program")
+	rm -rf "$WORK" && mkdir -p "$WORK" && cp "$program"*.jack "$WORK"
+	"$JACKC" -O "$WORK"
+
+	for golden in "$program"*_O.vm; do
+		class=$(basename "$golden" _O.vm)
+		if ! cmp -s "$golden" "$WORK/$class.vm"; then
+			echo "FAIL : $name/$class.vm differs from $name/$(basename "$golden")"
+			status=1
+		fi
+	done
+done
+
+# a pattern fires when leaving it out of the others changes the code
+rm -rf "$WORK" && mkdir -p "$WORK" && cp "$DIR/7Peephole/Main.jack" "$WORK"
+"$JACKC" --peephole=all "$WORK" && mv "$WORK/Main.vm" "$WORK/all.vm"
+
+for pattern in $PATTERNS; do
+	others=$(echo $PATTERNS | tr ' ' '\n' | grep -v "^$pattern\$" | paste -s -d, -)
+	"$JACKC" --peephole=$others "$WORK"
+	if cmp -s "$WORK/Main.vm" "$WORK/all.vm"; then
+		echo "FAIL : $pattern never fires on 7Peephole"
+		status=1
+	fi
+done
+
+[ $status -eq 0 ] && echo "optimized_test passed"
+exit $status
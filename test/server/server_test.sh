@@ -0,0 +1,78 @@
+#!/bin/sh
+# usage : server_test.sh JACKC
+# a file the lexer rejects, then a good one, are sent to the same server :
+# the first one must be reported as an error, the server must survive it;
+# an unchanged file is then restored from the warm cache, a path holding
+# a new line is sent as it is, and a client that never sends anything
+# must not block the server
+JACKC=$1
+DIR=$(cd "$(dirname "$0")" && pwd)
+SOCKET=/tmp/jack_server_test.$$
+
+"$JACKC" --serve "$SOCKET" -j 2 &
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null; rm -f "$SOCKET"' EXIT
+
+# wait for the socket
+i=0
+while [ ! -S "$SOCKET" ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done
+
+rm -f "$DIR/bad/Main.vm" "$DIR/good/Main.vm"
+
+ERRORS=$("$JACKC" --connect "$SOCKET" "$DIR/bad" 2>&1)
+case "$ERRORS" in
+	*"Escape character is not allowed in a string constant"*) ;;
+	*) echo "FAIL : bad file, got '$ERRORS'"; exit 1 ;;
+esac
+
+OUTPUT=$("$JACKC" --connect "$SOCKET" "$DIR/good" 2>&1)
+STATUS=$?
+if [ $STATUS -ne 0 ] || [ -n "$OUTPUT" ] || ! cmp -s "$DIR/good/Main.vm" "$DIR/good/Main.cmp"; then
+	echo "FAIL : good file after a bad one (status $STATUS) $OUTPUT"
+	exit 1
+fi
+
+# the server keeps the cache of the directory warm, even without -c :
+# an unchanged file is not compiled nor written again
+MARK=/tmp/jack_server_test.$$.mark
+sleep 1
+touch "$MARK"
+"$JACKC" --connect "$SOCKET" "$DIR/good" >/dev/null 2>&1
+if [ "$DIR/good/Main.vm" -nt "$MARK" ] || [ -d "$DIR/good/.jackcache" ]; then
+	rm -f "$MARK"
+	echo "FAIL : unchanged file compiled again"
+	exit 1
+fi
+rm -f "$MARK"
+
+# the arguments are sent with their size, a new line is part of the path
+NEWLINE_DIR="/tmp/jack_server_test.$$.a
+b"
+mkdir -p "$NEWLINE_DIR"
+cp "$DIR/good/Main.jack" "$NEWLINE_DIR/"
+OUTPUT=$("$JACKC" --connect "$SOCKET" "$NEWLINE_DIR" 2>&1)
+STATUS=$?
+if [ $STATUS -ne 0 ] || ! cmp -s "$NEWLINE_DIR/Main.vm" "$DIR/good/Main.cmp"; then
+	rm -rf "$NEWLINE_DIR"
+	echo "FAIL : path with a new line (status $STATUS) $OUTPUT"
+	exit 1
+fi
+rm -rf "$NEWLINE_DIR"
+
+# a client that connects and never sends its request is dropped
+# after the read deadline, the next one is still served
+rm -f "$DIR/good/Main.vm"
+perl -MIO::Socket::UNIX -e '$s = IO::Socket::UNIX->new(Peer => $ARGV[0]) or exit 1; sleep 30' "$SOCKET" &
+IDLE=$!
+trap 'kill $SERVER $IDLE 2>/dev/null; rm -f "$SOCKET"' EXIT
+sleep 0.5
+
+OUTPUT=$(timeout 20 "$JACKC" --connect "$SOCKET" "$DIR/good" 2>&1)
+STATUS=$?
+if [ $STATUS -ne 0 ] || ! cmp -s "$DIR/good/Main.vm" "$DIR/good/Main.cmp"; then
+	echo "FAIL : request behind an idle client (status $STATUS) $OUTPUT"
+	exit 1
+fi
+
+rm -f "$DIR/bad/Main.vm" "$DIR/good/Main.vm"
+echo "server_test passed"
@@ -0,0 +1,69 @@
+/* In-memory API (jack_library.h) : bad sources must come back
+ * as failed results with their errors, never stop the process.
+ * Built and run by run.sh
+ */
+#include <iostream>
+#include <string>
+#include "jack_library.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string &what)
+{
+	if (!condition)
+	{
+		cout << "FAIL : " << what << endl;
+		failures++;
+	}
+}
+
+static bool contains(const string &text, const string &part)
+{
+	return text.find(part) != string::npos;
+}
+
+int main()
+{
+	string good = "class Main { function int f() { return 1 + 2; } }";
+	CompileResult result = compile_source("Main", SourceView(good));
+	check(result.succeeded, "a good unit compiles");
+	check(result.diagnostics.empty(), "a good unit has no diagnostics");
+	check(contains(result.output, "function Main.f 0"), "the VM code is returned");
+
+	// a newline in a string constant used to exit the process
+	string newline = "class Main { function void f() { do Output.printString(\"a\nb\"); return; } }";
+	result = compile_source("Main", SourceView(newline));
+	check(!result.succeeded, "a newline in a string constant fails");
+	check(contains(result.diagnostics, "Error in \"Main\" Ln 1"), "the lexer error names the unit and line");
+	check(contains(result.diagnostics, "Escape character is not allowed in a string constant"), "the lexer error is reported");
+
+	string unclosed = "class Main { function void f() { do Output.printString(\"ab";
+	result = compile_source("Main", SourceView(unclosed));
+	check(!result.succeeded && contains(result.diagnostics, "A string constant is not closed"), "an unclosed string fails");
+
+	// used to be written on cout by JackTokenizer::intVal()
+	string integer = "class Main { function int f() { return 12ab; } }";
+	result = compile_source("Main", SourceView(integer));
+	check(!result.succeeded && contains(result.diagnostics, "Invalid integer constant"), "a malformed integer fails");
+
+	string overflow = "class Main { function int f() { return 99999999999; } }";
+	result = compile_source("Main", SourceView(overflow));
+	check(!result.succeeded && !result.diagnostics.empty(), "an integer out of range fails");
+
+	// the other units of a program are still compiled
+	vector<SourceUnit> units;
+	units.push_back( SourceUnit("Bad", SourceView(newline)) );
+	units.push_back( SourceUnit("Main", SourceView(good)) );
+	vector<CompileResult> results = compile_program(units);
+	check(results.size() == 2 && !results[0].succeeded && results[1].succeeded, "compile_program isolates a bad unit");
+
+	result = analyze_source("Main", SourceView(newline));
+	check(!result.succeeded && contains(result.diagnostics, "Escape character"), "the analyzer reports lexer errors");
+
+	if (failures == 0)
+		cout << "library_test passed" << endl;
+
+	return failures == 0 ? 0 : 1;
+}
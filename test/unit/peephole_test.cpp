@@ -0,0 +1,151 @@
+/* Peephole optimizer (peephole.h) : every pattern must fire on
+ * its own, and leave the code alone when it isn't enabled.
+ * Built and run by run.sh
+ */
+#include <iostream>
+#include <string>
+#include "peephole.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string &what)
+{
+	if (!condition)
+	{
+		cout << "FAIL : " << what << endl;
+		failures++;
+	}
+}
+
+// the label names are atoms, any value will do here
+static const Atom LABEL = 1;
+
+static VMInstruction push(SEGMENT seg, int index) { return VMInstruction(OP_PUSH, seg, NO_ATOM, index); }
+static VMInstruction pop(SEGMENT seg, int index) { return VMInstruction(OP_POP, seg, NO_ATOM, index); }
+static VMInstruction arithmetic(COMMAND cmd) { return VMInstruction(OP_ARITHMETIC, cmd); }
+static VMInstruction label(int index) { return VMInstruction(OP_LABEL, 0, LABEL, index); }
+static VMInstruction jump(int index) { return VMInstruction(OP_GOTO, 0, LABEL, index); }
+static VMInstruction jump_if(int index) { return VMInstruction(OP_IF, 0, LABEL, index); }
+static VMInstruction ret() { return VMInstruction(OP_RETURN); }
+
+// builds the code of 'function f 0' from a list ended by a return
+static VMCode subroutine(const VMInstruction *body, size_t size)
+{
+	VMCode code(1, VMInstruction(OP_FUNCTION, 0, 0, 0));
+	code.insert(code.end(), body, body + size);
+	return code;
+}
+
+static bool same_code(const VMCode &a, const VMCode &b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].opcode != b[i].opcode || a[i].arg != b[i].arg || a[i].name != b[i].name || a[i].index != b[i].index)
+			return false;
+	}
+
+	return true;
+}
+
+/* the pattern alone gives 'expected', every other pattern
+leaves 'before' as it is
+*/
+template <size_t N, size_t M>
+static void check_pattern(PEEPHOLE_PATTERN pattern, const VMInstruction (&before)[N],
+	const VMInstruction (&expected)[M], const string &what)
+{
+	VMCode code = subroutine(before, N);
+	PeepholeOptimizer(pattern).run(code);
+	check(same_code(code, subroutine(expected, M)), what + " fires");
+
+	code = subroutine(before, N);
+	PeepholeOptimizer(PEEP_ALL & ~pattern).run(code);
+	check(same_code(code, subroutine(before, N)), what + " is off when not enabled");
+}
+
+int main()
+{
+	{
+		VMInstruction before[] = { push(SEG_LOCAL, 0), pop(SEG_LOCAL, 0), ret() };
+		VMInstruction after[] = { ret() };
+		check_pattern(PEEP_PUSH_POP, before, after, "push-pop");
+	}
+
+	{
+		VMInstruction before[] = { push(SEG_ARG, 0), arithmetic(C_NOT), arithmetic(C_NOT), ret() };
+		VMInstruction after[] = { push(SEG_ARG, 0), ret() };
+		check_pattern(PEEP_DOUBLE_UNARY, before, after, "double-unary (not)");
+	}
+
+	{
+		VMInstruction before[] = { push(SEG_ARG, 0), arithmetic(C_NEG), arithmetic(C_NEG), ret() };
+		VMInstruction after[] = { push(SEG_ARG, 0), ret() };
+		check_pattern(PEEP_DOUBLE_UNARY, before, after, "double-unary (neg)");
+	}
+
+	{
+		// 'while (false)' never jumps, 'if (true)' always does
+		VMInstruction before[] = { push(SEG_CONST, 0), jump_if(0), push(SEG_CONST, 0), arithmetic(C_NOT), jump_if(1),
+			label(0), label(1), ret() };
+		VMInstruction after[] = { jump(1), label(0), label(1), ret() };
+		check_pattern(PEEP_CONSTANT_BRANCH, before, after, "constant-branch");
+	}
+
+	{
+		VMInstruction before[] = { push(SEG_CONST, 3), arithmetic(C_NEG), jump_if(0), label(0), ret() };
+		VMInstruction after[] = { jump(0), label(0), ret() };
+		check_pattern(PEEP_CONSTANT_BRANCH, before, after, "constant-branch (neg)");
+	}
+
+	{
+		VMInstruction before[] = { push(SEG_LOCAL, 1), pop(SEG_TEMP, 0), push(SEG_TEMP, 0), ret() };
+		VMInstruction after[] = { push(SEG_LOCAL, 1), ret() };
+		check_pattern(PEEP_TEMP_RELOAD, before, after, "temp-reload");
+	}
+
+	{
+		// 'let a[i] = x'
+		VMInstruction before[] = { push(SEG_LOCAL, 1), pop(SEG_TEMP, 0), pop(SEG_POINTER, 1), push(SEG_TEMP, 0),
+			pop(SEG_THAT, 0), ret() };
+		VMInstruction after[] = { pop(SEG_POINTER, 1), push(SEG_LOCAL, 1), pop(SEG_THAT, 0), ret() };
+		check_pattern(PEEP_TEMP_RELOAD, before, after, "temp-reload (array store)");
+	}
+
+	{
+		VMInstruction before[] = { jump(0), label(0), ret() };
+		VMInstruction after[] = { label(0), ret() };
+		check_pattern(PEEP_JUMP_TO_NEXT, before, after, "jump-to-next");
+	}
+
+	{
+		VMInstruction before[] = { jump(0), push(SEG_CONST, 1), pop(SEG_LOCAL, 0), label(0), ret(), push(SEG_CONST, 0), ret() };
+		VMInstruction after[] = { jump(0), label(0), ret() };
+		check_pattern(PEEP_DEAD_CODE, before, after, "dead-code");
+	}
+
+	{
+		// a rewrite enables the next one, down to an empty loop
+		VMInstruction before[] = { label(0), push(SEG_CONST, 0), arithmetic(C_NOT), arithmetic(C_NOT), arithmetic(C_NOT),
+			jump_if(1), jump(0), label(1), ret() };
+		VMInstruction after[] = { label(0), label(1), ret() };
+
+		VMCode code = subroutine(before, 9);
+		PeepholeOptimizer(PEEP_ALL).run(code);
+		check(same_code(code, subroutine(after, 3)), "the patterns chain");
+	}
+
+	unsigned int patterns;
+	check(parse_peephole_patterns("push-pop,dead-code", patterns) && patterns == (PEEP_PUSH_POP | PEEP_DEAD_CODE),
+		"a list of patterns is parsed");
+	check(!parse_peephole_patterns("push-pop,unknown", patterns), "an unknown pattern is rejected");
+
+	if (failures == 0)
+		cout << "peephole_test passed" << endl;
+
+	return failures == 0 ? 0 : 1;
+}
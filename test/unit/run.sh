@@ -0,0 +1,29 @@
+#!/bin/sh
+# builds every *_test.cpp of this directory against the compiler
+# sources (all but main.cpp) and runs them; needs g++ and Boost.
+# usage : run.sh [build directory]
+DIR=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$DIR/../.." && pwd)
+BUILD=${1:-/tmp/jack_unit_tests}
+CXX=${CXX:-g++}
+LIBS="-lboost_filesystem -lboost_system -lboost_iostreams -lboost_thread -lpthread"
+
+mkdir -p "$BUILD" || exit 1
+
+# the sources are compiled once for every test
+OBJECTS=
+for src in "$ROOT"/*.cpp; do
+	[ "$(basename "$src")" = "main.cpp" ] && continue
+	obj="$BUILD/$(basename "$src" .cpp).o"
+	OBJECTS="$OBJECTS $obj"
+	$CXX -O2 -w -c -o "$obj" "$src" || exit 1
+done
+
+status=0
+for test in "$DIR"/*_test.cpp; do
+	exe="$BUILD/$(basename "$test" .cpp)"
+	$CXX -O2 -w -I"$ROOT" -o "$exe" "$test" $OBJECTS $LIBS || exit 1
+	(cd "$DIR" && "$exe") || status=1
+done
+
+exit $status
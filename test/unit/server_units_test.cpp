@@ -0,0 +1,117 @@
+/* In-memory units sent to a compile server (compile_server.h) :
+ * every unit comes back with its own result, in the same order,
+ * whatever its size. Built and run by run.sh
+ */
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include "compile_server.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string &what)
+{
+	if (!condition)
+	{
+		cout << "FAIL : " << what << endl;
+		failures++;
+	}
+}
+
+static bool contains(const string &text, const string &part)
+{
+	return text.find(part) != string::npos;
+}
+
+// the server of main.cpp does the same, with its own options parser
+static int compile_units(const vector<string> &options, const vector<SourceUnit> &units,
+	vector<CompileResult> &results, ostream &err)
+{
+	if (!options.empty())
+	{
+		err << "invalid option for in-memory units : " << options[0] << endl;
+		return 1;
+	}
+
+	results = compile_program(units);
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (!results[i].succeeded)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int no_request(const vector<string>&, ostream&, ostream&)
+{
+	return 1;
+}
+
+int main()
+{
+	ostringstream socketPath;
+	socketPath << "/tmp/jack_units_test." << getpid();
+
+	// never destroyed : its thread still waits in accept() when the test ends
+	CompileServer *server = new CompileServer(socketPath.str(), &no_request, &compile_units);
+	check(server->isListening(), "the server listens");
+
+	boost::thread serving( boost::bind(&CompileServer::run, server) );
+	serving.detach();
+
+	// larger than one read, and a unit the lexer rejects between good ones
+	ostringstream big;
+	big << "class Big {\n";
+	for (int i = 0; i < 300; i++)
+	{
+		big << "\tfunction int f" << i << "() { return " << i << "; }\n";
+	}
+	big << "}\n";
+
+	string bigCode = big.str();
+	string bad = "class Bad { function void f() { do Output.printString(\"a\nb\"); return; } }";
+	string good = "class Main { function int f() { return Big.f7(); } }";
+
+	vector<SourceUnit> units;
+	units.push_back( SourceUnit("Big", SourceView(bigCode)) );
+	units.push_back( SourceUnit("Bad", SourceView(bad)) );
+	units.push_back( SourceUnit("Main", SourceView(good)) );
+
+	vector<CompileResult> results;
+	string errors;
+	int status = compile_on_server(socketPath.str(), vector<string>(), units, results, errors);
+
+	check(status == 1, "a failed unit gives the exit status 1");
+	check(results.size() == 3, "one result per unit");
+
+	if (results.size() == 3)
+	{
+		check(results[0].name == "Big" && results[0].succeeded && contains(results[0].output, "function Big.f299 0"),
+			"a unit larger than one read is compiled");
+		check(results[1].name == "Bad" && !results[1].succeeded
+			&& contains(results[1].diagnostics, "Escape character is not allowed in a string constant"),
+			"the lexer error of a unit comes back");
+		check(results[2].name == "Main" && results[2].succeeded && contains(results[2].output, "call Big.f7 0"),
+			"the units are compiled as one program");
+	}
+
+	status = compile_on_server(socketPath.str(), vector<string>(1, "-x"), units, results, errors);
+	check(status == 1 && results.empty() && contains(errors, "-x"), "an invalid option is reported");
+
+	check(compile_on_server("/tmp/jack_no_such_server", vector<string>(), units, results, errors) == -1,
+		"an unreachable server gives -1");
+
+	unlink(socketPath.str().c_str());
+
+	if (failures == 0)
+		cout << "server_units_test passed" << endl;
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/* Binary VM files (.vmb) : what the compiler writes must be read
+ * back to the same text, corrupt files must be rejected.
+ * Built and run by run.sh
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include "jack_library.h"
+#include "vmb_reader.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string &what)
+{
+	if (!condition)
+	{
+		cout << "FAIL : " << what << endl;
+		failures++;
+	}
+}
+
+static void write_file(const string &filename, const string &content)
+{
+	ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	out << content;
+}
+
+static bool reader_accepts(const string &filename, const string &content)
+{
+	write_file(filename, content);
+	VMBinaryReader reader(filename);
+	return reader.isValid();
+}
+
+int main()
+{
+	string source =
+		"class Main {\n"
+		"	static int count;\n"
+		"	function void main() {\n"
+		"		var int i;\n"
+		"		while (i < 10) { let i = i + 1; }\n"
+		"		if (i = 10) { do Output.printString(\"done\"); } else { let count = -i; }\n"
+		"		return;\n"
+		"	}\n"
+		"}\n";
+
+	CompileResult text = compile_source("Main", SourceView(source));
+
+	CodegenOptions options;
+	options.format = VM_BINARY;
+	CompileResult binary = compile_source("Main", SourceView(source), 0, options);
+
+	check(text.succeeded && binary.succeeded, "the unit compiles");
+
+	string filename = "vmb_reader_test.vmb";
+
+	// round trip : the text written back is the text output
+	write_file(filename, binary.output);
+	{
+		VMBinaryReader reader(filename);
+		check(reader.isValid(), "the compiler output is accepted");
+
+		ostringstream back;
+		reader.writeText(back);
+		check(back.str() == text.output, "the file reads back to the text output");
+		check(reader.instructionCount() > 0 && reader.instruction(0).opcode == OP_FUNCTION, "the first record is the function");
+		check(string(reader.name(reader.instruction(0).name)) == "Main.main", "names come from the string table");
+	}
+
+	// corrupt files, the records are at the end
+	size_t first_record = binary.output.size();
+	{
+		VMBinaryReader reader(filename);
+		first_record -= reader.instructionCount() * VMB_RECORD_SIZE;
+	}
+
+	string bad = binary.output;
+	bad[0] = 'X';
+	check(!reader_accepts(filename, bad), "a wrong magic is rejected");
+
+	bad = binary.output.substr(0, binary.output.size() - 5);
+	check(!reader_accepts(filename, bad), "a truncated file is rejected");
+
+	bad = binary.output;
+	bad[first_record] = (char)200;
+	check(!reader_accepts(filename, bad), "an unknown opcode is rejected");
+
+	bad = binary.output;
+	bad[first_record] = (char)OP_PUSH;
+	bad[first_record + 1] = (char)99;
+	check(!reader_accepts(filename, bad), "an unknown segment is rejected");
+
+	bad = binary.output;
+	bad[first_record] = (char)OP_ARITHMETIC;
+	bad[first_record + 1] = (char)99;
+	check(!reader_accepts(filename, bad), "an unknown command is rejected");
+
+	bad = binary.output;
+	bad[first_record + 4] = (char)0x7F;
+	check(!reader_accepts(filename, bad), "a name outside the string table is rejected");
+
+	check(!reader_accepts(filename, ""), "an empty file is rejected");
+
+	remove(filename.c_str());
+
+	if (failures == 0)
+		cout << "vmb_reader_test passed" << endl;
+
+	return failures == 0 ? 0 : 1;
+}
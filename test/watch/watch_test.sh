@@ -0,0 +1,38 @@
+#!/bin/sh
+# usage : watch_test.sh JACKC
+# a file removed while watched must take its generated .vm with
+# it, and the files calling its class must be compiled again
+JACKC=$1
+DIR=$(cd "$(dirname "$0")" && pwd)
+WORK=/tmp/jack_watch_test.$$
+
+mkdir -p "$WORK" || exit 1
+cp "$DIR/../p11/5Pong/"*.jack "$WORK"
+
+"$JACKC" --watch "$WORK" > "$WORK.log" 2>&1 &
+WATCHER=$!
+trap 'kill $WATCHER 2>/dev/null; rm -rf "$WORK" "$WORK.log"' EXIT
+
+# wait for the first build
+i=0
+while [ ! -f "$WORK/PongGame.vm" ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done
+
+rm "$WORK/Bat.jack"
+
+i=0
+while [ -f "$WORK/Bat.vm" ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done
+
+if [ -f "$WORK/Bat.vm" ]; then
+	echo "FAIL : the .vm of a removed file is left in place"
+	exit 1
+fi
+
+# PongGame calls Bat : it's compiled again after the removal
+sleep 0.5
+if ! grep -q "^1 file(s) compiled" "$WORK.log"; then
+	echo "FAIL : the callers of a removed class weren't compiled again"
+	cat "$WORK.log"
+	exit 1
+fi
+
+echo "watch_test passed"
@@ -0,0 +1,134 @@
+#include <boost/bind.hpp>
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int nThreads)
+	:m_queued(0), m_pending(0), m_stop(false), m_next(0)
+{
+	if (nThreads < 1)
+		nThreads = 1;
+
+	for (int i = 0; i < nThreads; i++)
+	{
+		m_queues.push_back(new WorkQueue());
+	}
+
+	for (int i = 0; i < nThreads; i++)
+	{
+		m_threads.create_thread( boost::bind(&ThreadPool::run, this, i) );
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	wait();
+
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+	m_threads.join_all();
+
+	for (vector<WorkQueue*>::iterator it = m_queues.begin(), it_end = m_queues.end();
+		it != it_end;
+		++it)
+	{
+		delete *it;
+	}
+}
+
+void ThreadPool::submit(Task task)
+{
+	{
+		// the counters change with the push : a worker can't take
+		// the task before it's counted
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+
+		// deal tasks round-robin
+		WorkQueue *queue = m_queues[m_next++ % m_queues.size()];
+		{
+			boost::unique_lock<boost::mutex> queue_lock(queue->mutex);
+			queue->tasks.push_back(task);
+		}
+
+		m_queued++;
+		m_pending++;
+	}
+	m_cond.notify_all();
+}
+
+void ThreadPool::wait()
+{
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	while (m_pending > 0)
+	{
+		m_cond.wait(lock);
+	}
+}
+
+bool ThreadPool::popTask(int index, Task &task)
+{
+	// our own queue first (LIFO)
+	{
+		WorkQueue *own = m_queues[index];
+		boost::unique_lock<boost::mutex> lock(own->mutex);
+		if (!own->tasks.empty())
+		{
+			task = own->tasks.back();
+			own->tasks.pop_back();
+			return true;
+		}
+	}
+
+	// then steal from the others (FIFO)
+	int n = m_queues.size();
+	for (int i = 1; i < n; i++)
+	{
+		WorkQueue *victim = m_queues[(index + i) % n];
+		boost::unique_lock<boost::mutex> lock(victim->mutex);
+		if (!victim->tasks.empty())
+		{
+			task = victim->tasks.front();
+			victim->tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::run(int index)
+{
+	for (;;)
+	{
+		Task task;
+
+		if (popTask(index, task))
+		{
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				m_queued--;
+			}
+
+			task();
+
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			if (--m_pending == 0)
+			{
+				m_cond.notify_all();
+			}
+			continue;
+		}
+
+		// nothing to do : sleep until a task is submitted
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		while (m_queued == 0 && !m_stop)
+		{
+			m_cond.wait(lock);
+		}
+		if (m_stop)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <deque>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+using std::deque;
+using std::vector;
+
+/**
+Work-stealing thread pool : each worker has its own
+task queue (tasks are dealt round-robin); a worker pops
+its own tasks from the back and, once its queue is empty,
+steals from the front of the other queues
+*/
+class ThreadPool : private boost::noncopyable {
+public:
+	typedef boost::function<void ()> Task;
+
+	ThreadPool(int nThreads);
+	/**
+	Waits for every submitted task, then stops the workers
+	*/
+	~ThreadPool();
+
+	/**
+	Queues a task; it must not throw
+	*/
+	void submit(Task task);
+	/**
+	Blocks until every submitted task is done
+	*/
+	void wait();
+
+private:
+	struct WorkQueue {
+		boost::mutex mutex;
+		deque<Task> tasks;
+	};
+
+	vector<WorkQueue*> m_queues;
+	boost::thread_group m_threads;
+
+	// protects the counters below, taken before the mutex of a queue
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	// tasks waiting in a queue / not finished yet
+	int m_queued, m_pending;
+	bool m_stop;
+	unsigned int m_next;
+
+	void run(int index);
+	bool popTask(int index, Task &task);
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define _TYPE_UTILS_H
 
 #include <string>
+#include <cstring>
 
 using std::string;
 
@@ -151,6 +152,68 @@ inline string keyword_to_string(TYPE_KEYWORD tk)
 	}
 }
 
+/* recognize a keyword from its spelling : we switch on the length
+ * and the first char, so at most one string comparison is made
+ */
+inline TYPE_KEYWORD string_to_keyword(const char *s, size_t len)
+{
+	// same order as TYPE_KEYWORD
+	static const char *const spelling[] = {
+		"class", "method", "function", "constructor", "int", "boolean", "char",
+		"void", "var", "static", "field", "let", "do", "if", "else", "while",
+		"return", "true", "false", "null", "this"
+	};
+
+	TYPE_KEYWORD tk = KW_UNKNOWN;
+
+	switch ( len )
+	{
+	case 2:
+		if (s[0] == 'd') tk = KW_DO;
+		else if (s[0] == 'i') tk = KW_IF;
+		break;
+	case 3:
+		if (s[0] == 'i') tk = KW_INT;
+		else if (s[0] == 'v') tk = KW_VAR;
+		else if (s[0] == 'l') tk = KW_LET;
+		break;
+	case 4:
+		if (s[0] == 'c') tk = KW_CHAR;
+		else if (s[0] == 'v') tk = KW_VOID;
+		else if (s[0] == 'e') tk = KW_ELSE;
+		else if (s[0] == 'n') tk = KW_NULL;
+		else if (s[0] == 't') tk = (s[1] == 'r') ? KW_TRUE : KW_THIS;
+		break;
+	case 5:
+		if (s[0] == 'c') tk = KW_CLASS;
+		else if (s[0] == 'f') tk = (s[1] == 'i') ? KW_FIELD : KW_FALSE;
+		else if (s[0] == 'w') tk = KW_WHILE;
+		break;
+	case 6:
+		if (s[0] == 'm') tk = KW_METHOD;
+		else if (s[0] == 's') tk = KW_STATIC;
+		else if (s[0] == 'r') tk = KW_RETURN;
+		break;
+	case 7:
+		if (s[0] == 'b') tk = KW_BOOLEAN;
+		break;
+	case 8:
+		if (s[0] == 'f') tk = KW_FUNCTION;
+		break;
+	case 11:
+		if (s[0] == 'c') tk = KW_CONSTRUCTOR;
+		break;
+	}
+
+	// the candidate must be spelled exactly the same
+	if (tk != KW_UNKNOWN && memcmp(spelling[tk], s, len) != 0)
+	{
+		tk = KW_UNKNOWN;
+	}
+
+	return tk;
+}
+
 inline string kind_to_string(KIND k)
 {
 	switch ( k )
@@ -295,14 +358,4 @@ public:
 	SubroutineInfo(string t, string k, int i):type(t), kind(k), nArgs(i) {}
 };
 
-struct SymbolInfo {
-public:
-	string type;
-	KIND kind;
-	int index;
-
-	SymbolInfo():type(""), kind(K_NONE), index(0) {}
-	SymbolInfo(string t, KIND k, int i):type(t), kind(k), index(i) {}
-};
-
 #endif
@@ -0,0 +1,62 @@
+#ifndef _VM_CODE_H
+#define _VM_CODE_H
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "string_interner.h"
+#include "type_utils.h"
+
+using std::vector;
+
+/* Compact in-memory form of the VM code : VMWriter
+ * records one VMInstruction per command and emits the
+ * text only once the class is compiled, so passes can
+ * inspect or rewrite the instructions before.
+ * Function and label names are atoms of the writer's
+ * own interner (see VMWriter::names()).
+ */
+
+enum VM_OPCODE {
+	OP_PUSH,		// segment index
+	OP_POP,			// segment index
+	OP_ARITHMETIC,	// command
+	OP_LABEL,		// name index (the label is name + index)
+	OP_GOTO,		// name index
+	OP_IF,			// name index
+	OP_CALL,		// name index (nArgs)
+	OP_FUNCTION,	// name index (nLocals)
+	OP_RETURN
+};
+
+struct VMInstruction {
+public:
+	unsigned char opcode;
+	// SEGMENT for push/pop, COMMAND for arithmetic
+	unsigned char arg;
+	Atom name;
+	int index;
+
+	VMInstruction(VM_OPCODE op = OP_RETURN, unsigned char a = 0, Atom n = NO_ATOM, int i = 0)
+		:opcode((unsigned char)op), arg(a), name(n), index(i)
+	{}
+
+	SEGMENT segment() const { return (SEGMENT)arg; }
+	COMMAND command() const { return (COMMAND)arg; }
+};
+
+// the instructions of one subroutine, starting with its OP_FUNCTION
+typedef vector<VMInstruction> VMCode;
+
+/* Binary form (.vmb), every integer is little-endian :
+ *	header		"JVMB" <version> <nStrings> <stringBytes> <nInstructions>	(5 x 4 bytes)
+ *	offsets		<offset> once per string, from the start of the strings	(4 bytes each)
+ *	strings		NUL-terminated names, padded to a multiple of 4 bytes	(stringBytes)
+ *	records		<opcode> <arg> 0 0 <name> <index>	(1 + 1 + 2 + 4 + 4 bytes each)
+ * the name of a record is an index in the string table, or NO_ATOM
+ */
+const char VMB_MAGIC[] = "JVMB";
+const boost::uint32_t VMB_VERSION = 1;
+const size_t VMB_HEADER_SIZE = 20;
+const size_t VMB_RECORD_SIZE = 12;
+
+#endif
@@ -1,63 +1,286 @@
-
-
 #include "vm_writer.h"
 
 using namespace std;
 
-VMWriter::VMWriter(path p)
+// the buffer is written to the output once it reaches this size
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+// digits are produced backwards, without the locale of a stream
+static void append_int(string &out, int value)
+{
+	char digits[12];
+	char *end = digits + sizeof(digits);
+	char *cur = end;
+	unsigned int abs_value = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+	do
+	{
+		*--cur = (char)('0' + abs_value % 10);
+		abs_value /= 10;
+	} while (abs_value != 0);
+
+	if (value < 0)
+		*--cur = '-';
+
+	out.append( cur, end );
+}
+
+VMWriter::VMWriter(path p, ostream *out, VM_FORMAT format)
+	:m_out(out ? *out : m_file), m_format(format)
 {
 	// initialize the VM Writer module
-	p.replace_extension( ".vm" );
+	if (!out)
+	{
+		if (m_format == VM_BINARY)
+		{
+			p.replace_extension( ".vmb" );
+			m_file.open( p.c_str(), ios::out | ios::binary );
+		}
+		else
+		{
+			p.replace_extension( ".vm" );
+			m_file.open( p.c_str() );
+		}
+	}
+
+	m_buffer.reserve( CHUNK_SIZE + 256 );
+}
+
+VMWriter::~VMWriter()
+{
+	flushBuffer();
+}
+
+void VMWriter::endLine()
+{
+	m_buffer += '\n';
+
+	if (m_buffer.size() >= CHUNK_SIZE)
+		flushBuffer();
+}
+
+void VMWriter::flushBuffer()
+{
+	if (m_buffer.empty())
+		return;
+
+	m_out.write( m_buffer.data(), m_buffer.size() );
+	m_buffer.clear();
+}
+
+void VMWriter::record(const VMInstruction &inst)
+{
+	// a function starts the code of a new subroutine
+	if (inst.opcode == OP_FUNCTION || m_subroutines.empty())
+		m_subroutines.push_back( VMCode() );
+
+	m_subroutines.back().push_back( inst );
+}
+
+size_t VMWriter::mark() const
+{
+	return m_subroutines.empty() ? 0 : m_subroutines.back().size();
+}
+
+void VMWriter::truncate(size_t position)
+{
+	if (!m_subroutines.empty() && position < m_subroutines.back().size())
+		m_subroutines.back().resize( position );
+}
 
-	m_out.open( p.c_str() );
+void VMWriter::erase(size_t from, size_t to)
+{
+	if (!m_subroutines.empty() && from < to && to <= m_subroutines.back().size())
+		m_subroutines.back().erase( m_subroutines.back().begin() + from, m_subroutines.back().begin() + to );
 }
 
 void VMWriter::writePush(SEGMENT seg, int index)
 {
-	m_out << "push " << segment_to_string(seg) << " " << index << endl;
+	record( VMInstruction(OP_PUSH, (unsigned char)seg, NO_ATOM, index) );
 }
 
 void VMWriter::writePop(SEGMENT seg, int index)
 {
-	m_out << "pop " << segment_to_string(seg) << " " << index << endl;
+	record( VMInstruction(OP_POP, (unsigned char)seg, NO_ATOM, index) );
 }
 
 void VMWriter::writeArithmetic(COMMAND cmd)
 {
-	m_out << command_to_string(cmd) << endl;
+	record( VMInstruction(OP_ARITHMETIC, (unsigned char)cmd) );
 }
 
-void VMWriter::writeLabel(string label, int counter)
+void VMWriter::writeLabel(const string &label, int counter)
 {
-	m_out << "label " << label << counter << endl;
+	record( VMInstruction(OP_LABEL, 0, m_names.intern(label), counter) );
 }
 
-void VMWriter::writeGoto(string label, int counter)
+void VMWriter::writeGoto(const string &label, int counter)
 {
-	m_out << "goto " << label << counter << endl;
+	record( VMInstruction(OP_GOTO, 0, m_names.intern(label), counter) );
 }
 
-void VMWriter::writeIf(string label, int counter)
+void VMWriter::writeIf(const string &label, int counter)
 {
-	m_out << "if-goto " << label << counter << endl;
+	record( VMInstruction(OP_IF, 0, m_names.intern(label), counter) );
 }
 
-void VMWriter::writeCall(string name, int nArgs)
+void VMWriter::writeCall(const string &name, int nArgs)
 {
-	m_out << "call " << name << " " << nArgs << endl;
+	record( VMInstruction(OP_CALL, 0, m_names.intern(name), nArgs) );
 }
 
-void VMWriter::writeFunction(string name, int nArgs)
+void VMWriter::writeFunction(const string &name, int nArgs)
 {
-	m_out << "function " << name << " " << nArgs << endl;
+	record( VMInstruction(OP_FUNCTION, 0, m_names.intern(name), nArgs) );
 }
 
 void VMWriter::writeReturn()
 {
-	m_out << "return" << endl;
+	record( VMInstruction(OP_RETURN) );
+}
+
+void format_instruction(const VMInstruction &inst, const StringInterner &names, string &out)
+{
+	switch ( inst.opcode )
+	{
+	case OP_PUSH:
+		out.append( "push " );
+		out.append( segment_to_string(inst.segment()) );
+		out.append( " " );
+		append_int( out, inst.index );
+		break;
+	case OP_POP:
+		out.append( "pop " );
+		out.append( segment_to_string(inst.segment()) );
+		out.append( " " );
+		append_int( out, inst.index );
+		break;
+	case OP_ARITHMETIC:
+		out.append( command_to_string(inst.command()) );
+		break;
+	case OP_LABEL:
+		out.append( "label " );
+		out.append( names.str(inst.name) );
+		append_int( out, inst.index );
+		break;
+	case OP_GOTO:
+		out.append( "goto " );
+		out.append( names.str(inst.name) );
+		append_int( out, inst.index );
+		break;
+	case OP_IF:
+		out.append( "if-goto " );
+		out.append( names.str(inst.name) );
+		append_int( out, inst.index );
+		break;
+	case OP_CALL:
+		out.append( "call " );
+		out.append( names.str(inst.name) );
+		out.append( " " );
+		append_int( out, inst.index );
+		break;
+	case OP_FUNCTION:
+		out.append( "function " );
+		out.append( names.str(inst.name) );
+		out.append( " " );
+		append_int( out, inst.index );
+		break;
+	case OP_RETURN:
+		out.append( "return" );
+		break;
+	}
+}
+
+void format_instruction(const VMInstruction &inst, const StringInterner &names, ostream &out)
+{
+	string text;
+	format_instruction(inst, names, text);
+	out.write( text.data(), text.size() );
+}
+
+void VMWriter::emit(const VMInstruction &inst)
+{
+	format_instruction(inst, m_names, m_buffer);
+	endLine();
+}
+
+void VMWriter::appendWord(boost::uint32_t value)
+{
+	// little-endian whatever the host is
+	m_buffer += (char)(value & 0xFF);
+	m_buffer += (char)((value >> 8) & 0xFF);
+	m_buffer += (char)((value >> 16) & 0xFF);
+	m_buffer += (char)((value >> 24) & 0xFF);
+}
+
+void VMWriter::emitBinary()
+{
+	// the atoms of the names are their index in the string table
+	vector<boost::uint32_t> offsets;
+	string strings;
+
+	for (Atom atom = 0; atom < m_names.size(); atom++)
+	{
+		offsets.push_back( (boost::uint32_t)strings.size() );
+		strings += m_names.str(atom);
+		strings += '\0';
+	}
+
+	while (strings.size() % 4 != 0)
+		strings += '\0';
+
+	size_t nInstructions = 0;
+	for (vector<VMCode>::const_iterator sub = m_subroutines.begin(), sub_end = m_subroutines.end(); sub != sub_end; ++sub)
+		nInstructions += sub->size();
+
+	m_buffer.append( VMB_MAGIC, 4 );
+	appendWord( VMB_VERSION );
+	appendWord( (boost::uint32_t)offsets.size() );
+	appendWord( (boost::uint32_t)strings.size() );
+	appendWord( (boost::uint32_t)nInstructions );
+
+	for (vector<boost::uint32_t>::const_iterator it = offsets.begin(), it_end = offsets.end(); it != it_end; ++it)
+		appendWord( *it );
+
+	m_buffer += strings;
+
+	for (vector<VMCode>::const_iterator sub = m_subroutines.begin(), sub_end = m_subroutines.end(); sub != sub_end; ++sub)
+	{
+		for (VMCode::const_iterator it = sub->begin(), it_end = sub->end(); it != it_end; ++it)
+		{
+			m_buffer += (char)it->opcode;
+			m_buffer += (char)it->arg;
+			m_buffer += '\0';
+			m_buffer += '\0';
+			appendWord( it->name );
+			appendWord( (boost::uint32_t)it->index );
+
+			if (m_buffer.size() >= CHUNK_SIZE)
+				flushBuffer();
+		}
+	}
 }
 
 void VMWriter::close()
 {
-	m_out.close();
-}
\ No newline at end of file
+	if (m_format == VM_BINARY)
+	{
+		emitBinary();
+	}
+	else
+	{
+		for (vector<VMCode>::const_iterator sub = m_subroutines.begin(), sub_end = m_subroutines.end(); sub != sub_end; ++sub)
+		{
+			for (VMCode::const_iterator it = sub->begin(), it_end = sub->end(); it != it_end; ++it)
+				emit( *it );
+		}
+	}
+
+	m_subroutines.clear();
+
+	flushBuffer();
+	m_out.flush();
+
+	if (m_file.is_open())
+		m_file.close();
+}
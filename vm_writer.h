@@ -2,32 +2,85 @@
 #define _VM_WRITER_H
 
 #include <fstream>
+#include <ostream>
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include "type_utils.h"
+#include "vm_code.h"
+#include "string_interner.h"
+#include "codegen_options.h"
 
 using std::ofstream;
+using std::ostream;
 using std::string;
+using std::vector;
 using boost::filesystem::path;
 
+/**
+Text form of an instruction (.vm), without the end of line :
+its name is an atom of 'names'
+*/
+void format_instruction(const VMInstruction &inst, const StringInterner &names, string &out);
+void format_instruction(const VMInstruction &inst, const StringInterner &names, ostream &out);
 
 class VMWriter {
 public:
-	VMWriter(path p);
+	/**
+	The VM code goes to out, or when it's null,
+	to the .vm (.vmb) file next to the source p
+	*/
+	VMWriter(path p, ostream *out = 0, VM_FORMAT format = VM_TEXT);
+	~VMWriter();
 
 	void writePush(SEGMENT seg, int index);
 	void writePop(SEGMENT seg, int index);
 	void writeArithmetic(COMMAND cmd);
-	void writeLabel(string label, int counter);
-	void writeGoto(string label, int counter);
-	void writeIf(string label, int counter);
-	void writeCall(string name, int nArgs);
-	void writeFunction(string name, int nArgs);
+	void writeLabel(const string &label, int counter);
+	void writeGoto(const string &label, int counter);
+	void writeIf(const string &label, int counter);
+	void writeCall(const string &name, int nArgs);
+	void writeFunction(const string &name, int nArgs);
 	void writeReturn();
+	/**
+	Position in the code of the current subroutine : what
+	was written after it can be dropped with truncate()
+	*/
+	size_t mark() const;
+	void truncate(size_t position);
+	// drops the instructions in [from, to) of the current subroutine
+	void erase(size_t from, size_t to);
+	const VMInstruction& instruction(size_t position) const { return m_subroutines.back()[position]; }
+	/**
+	Emits every recorded subroutine, as text or binary
+	*/
 	void close();
 
+	/**
+	The recorded code, one VMCode per subroutine :
+	passes may rewrite it before close()
+	*/
+	vector<VMCode>& subroutines() { return m_subroutines; }
+	const StringInterner& names() const { return m_names; }
+
 private:
-	ofstream m_out;
+	ofstream m_file;
+	ostream &m_out;
+	VM_FORMAT m_format;
+	vector<VMCode> m_subroutines;
+	StringInterner m_names;
+	/**
+	The text is formatted here and written in big chunks,
+	instead of one flushed line per instruction
+	*/
+	string m_buffer;
+
+	void endLine();
+	void flushBuffer();
+	void record(const VMInstruction &inst);
+	void emit(const VMInstruction &inst);
+	void appendWord(boost::uint32_t value);
+	void emitBinary();
 };
 
 #endif
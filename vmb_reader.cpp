@@ -0,0 +1,147 @@
+#include <cstring>
+#include <exception>
+#include "vmb_reader.h"
+#include "vm_writer.h"
+
+using namespace std;
+
+static boost::uint32_t read_word(const unsigned char *bytes)
+{
+	return (boost::uint32_t)bytes[0] | ((boost::uint32_t)bytes[1] << 8)
+		| ((boost::uint32_t)bytes[2] << 16) | ((boost::uint32_t)bytes[3] << 24);
+}
+
+VMBinaryReader::VMBinaryReader(path p)
+	:m_valid(false), m_nStrings(0), m_nInstructions(0), m_offsets(0), m_strings(0), m_records(0)
+{
+	try
+	{
+		m_mapping.open( p.string() );
+	}
+	catch (const exception&)
+	{
+		return;
+	}
+
+	load();
+}
+
+void VMBinaryReader::load()
+{
+	const unsigned char *data = (const unsigned char*)m_mapping.data();
+	size_t size = m_mapping.size();
+
+	if (size < VMB_HEADER_SIZE || memcmp(data, VMB_MAGIC, 4) != 0 || read_word(data + 4) != VMB_VERSION)
+		return;
+
+	size_t nStrings = read_word(data + 8);
+	size_t stringBytes = read_word(data + 12);
+	size_t nInstructions = read_word(data + 16);
+
+	// sizes are checked one by one, so that nothing can overflow
+	size_t rest = size - VMB_HEADER_SIZE;
+	if (nStrings > rest / 4)
+		return;
+	rest -= nStrings * 4;
+
+	if (stringBytes > rest)
+		return;
+	rest -= stringBytes;
+
+	if (nInstructions > rest / VMB_RECORD_SIZE || rest != nInstructions * VMB_RECORD_SIZE)
+		return;
+
+	m_offsets = data + VMB_HEADER_SIZE;
+	m_strings = (const char*)(m_offsets + nStrings * 4);
+	m_records = (const unsigned char*)m_strings + stringBytes;
+
+	// every name must end inside the string table
+	if (nStrings > 0 && (stringBytes == 0 || m_strings[stringBytes - 1] != '\0'))
+		return;
+
+	for (size_t i = 0; i < nStrings; i++)
+	{
+		if (read_word(m_offsets + i * 4) >= stringBytes)
+			return;
+	}
+
+	m_nStrings = nStrings;
+	m_nInstructions = nInstructions;
+
+	// the text form can be written for any record that was accepted
+	for (size_t i = 0; i < nInstructions; i++)
+	{
+		if (!validRecord(m_records + i * VMB_RECORD_SIZE))
+		{
+			m_nStrings = 0;
+			m_nInstructions = 0;
+			return;
+		}
+	}
+
+	m_valid = true;
+}
+
+bool VMBinaryReader::validRecord(const unsigned char *record) const
+{
+	Atom name = read_word(record + 4);
+
+	switch ( record[0] )
+	{
+	case OP_PUSH:
+		return record[1] <= SEG_TEMP;
+	case OP_POP:
+		return record[1] <= SEG_TEMP && record[1] != SEG_CONST;
+	case OP_ARITHMETIC:
+		return record[1] <= C_NOT;
+	case OP_LABEL:
+	case OP_GOTO:
+	case OP_IF:
+	case OP_CALL:
+	case OP_FUNCTION:
+		return name < m_nStrings;
+	case OP_RETURN:
+		return true;
+	default:
+		return false;
+	}
+}
+
+const char* VMBinaryReader::name(Atom atom) const
+{
+	if (atom >= m_nStrings)
+		return "";
+
+	return m_strings + read_word(m_offsets + atom * 4);
+}
+
+VMInstruction VMBinaryReader::instruction(size_t i) const
+{
+	const unsigned char *record = m_records + i * VMB_RECORD_SIZE;
+
+	return VMInstruction( (VM_OPCODE)record[0], record[1], read_word(record + 4), (int)read_word(record + 8) );
+}
+
+void VMBinaryReader::writeText(ostream &out) const
+{
+	// the names go through an interner, as in the writer;
+	// atoms[i] is the atom of the string i of the table
+	StringInterner names;
+	vector<Atom> atoms(m_nStrings);
+
+	for (size_t i = 0; i < m_nStrings; i++)
+	{
+		const char *str = name((Atom)i);
+		atoms[i] = names.intern(str, strlen(str));
+	}
+
+	for (size_t i = 0; i < m_nInstructions; i++)
+	{
+		VMInstruction inst = instruction(i);
+		if (inst.name != NO_ATOM)
+			inst.name = atoms[inst.name];
+
+		format_instruction(inst, names, out);
+		out << '\n';
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef _VMB_READER_H
+#define _VMB_READER_H
+
+#include <ostream>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "vm_code.h"
+
+using std::ostream;
+using boost::filesystem::path;
+
+/**
+Read-only access to a binary VM file (.vmb, see vm_code.h),
+for the tools loading the generated code : the file is
+memory-mapped, names and instructions are decoded in place
+when asked for
+*/
+class VMBinaryReader : private boost::noncopyable {
+public:
+	VMBinaryReader(path p);
+
+	// the file could be mapped, its layout is consistent
+	// and every record is a valid instruction
+	bool isValid() const { return m_valid; }
+
+	size_t stringCount() const { return m_nStrings; }
+	size_t instructionCount() const { return m_nInstructions; }
+
+	/**
+	NUL-terminated name of the string table,
+	an empty string for NO_ATOM
+	*/
+	const char* name(Atom atom) const;
+	VMInstruction instruction(size_t i) const;
+
+	/**
+	Writes the instructions back in the text form (.vm)
+	*/
+	void writeText(ostream &out) const;
+
+private:
+	boost::iostreams::mapped_file_source m_mapping;
+	bool m_valid;
+	size_t m_nStrings, m_nInstructions;
+	const unsigned char *m_offsets;
+	const char *m_strings;
+	const unsigned char *m_records;
+
+	void load();
+	bool validRecord(const unsigned char *record) const;
+};
+
+#endif
@@ -25,15 +25,18 @@ void XMLCompilationEngine::Dec_tab()
  * CONSTRUCTOR
  * 
  **********************************************/
-XMLCompilationEngine::XMLCompilationEngine(JackTokenizer &jtok, boost::filesystem::path p)
-	:CompilationEngine(jtok)
+XMLCompilationEngine::XMLCompilationEngine(JackTokenizer &jtok, boost::filesystem::path p, ostream &diag, ostream *out)
+	:CompilationEngine(jtok), m_out(out ? *out : m_file), m_diag(diag), m_failed(false)
 {
 	// get the filename
 	m_fileName = p.filename().stem().string();
 	
 	// initialize the ofstream
-	p.replace_extension( ".xml" );
-	m_out.open( p.c_str() );
+	if (!out)
+	{
+		p.replace_extension( ".xml" );
+		m_file.open( p.c_str() );
+	}
 	
 
 	// initialize internal vars
@@ -75,7 +78,15 @@ XMLCompilationEngine::XMLCompilationEngine(JackTokenizer &jtok, boost::filesyste
 	// compile class
 	XMLCompilationEngine::compileClass();
 
-	m_out.close();
+	if (!out)
+	{
+		m_file.close();
+	}
+}
+
+bool XMLCompilationEngine::hasFailed()
+{
+	return m_failed;
 }
 
 /******************************************
@@ -401,9 +412,15 @@ void XMLCompilationEngine::compileClass()
 		m_jtok.advance();
 		outputSymbol('}');
 	}
+	catch (const LexicalError& e)
+	{
+		m_diag << JackError(e.message(), m_fileName, e.line(), e.column()).what() << endl;
+		m_failed = true;
+	}
 	catch (const exception& e)
 	{
-		cerr << e.what() << endl;
+		m_diag << e.what() << endl;
+		m_failed = true;
 	}
 
 	m_out << "</class>" << endl;